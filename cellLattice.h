@@ -0,0 +1,247 @@
+/////////////////////////////////////////////////////////////////////////////
+// Compact storage for the bacterial lattice
+// Every per-site quantity lives in its own narrow plane (structure of arrays),
+// and all planes share a single allocation, each starting on a cache line.
+// A site costs 12 bytes here instead of the 64 bytes the old long[][] arrays
+// needed, which is what makes 4096x4096 colonies fit comfortably in memory.
+// The engines add a bit or two per site for their bitmaps, and the event
+// engine 8 bytes more for its schedule (see eventScheduler.h).
+// The block can also be mapped from a checkpoint file (see checkpoint.h).
+//
+// Every plane has a one-site halo around the lattice, so the 8 neighbours
+// of any site are at fixed offsets (+-1, +-stride, ...) and never outside the
+// plane. With closed boundaries the halo is filled with blockedSite, which is
+// never free and never a bacterium. With periodic boundaries each halo site
+// holds the state of the site on the opposite edge it stands for: mirror()
+// keeps it up to date whenever an edge site changes, and wrap() turns a halo
+// site into that interior site before anything is written to it.
+/////////////////////////////////////////////////////////////////////////////
+#ifndef CELL_LATTICE_H
+#define CELL_LATTICE_H
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <sys/mman.h>
+
+const long cacheLineBytes = 64;
+const uint8_t blockedSite = 0xff; //state of the halo sites of a lattice with closed boundaries
+
+class CellLattice
+{
+public:
+    long size; //number of sites along each side of the (square) lattice
+    long stride; //distance between the starts of two consecutive rows in every plane, size + 2 with the halo
+    long cellCount; //number of elements in every plane, halo included
+    bool periodic; //how the halo is filled, see setBoundary
+
+    uint8_t *state; //0: empty; 1: healthy; 2 + 2p: lysogenic for phage p; 3 + 2p: lytic for phage p (2/4 lysogenic A/B, 3/5 lytic A/B)
+    int8_t *infectionStatus; //remaining infection tries of the phage in infectingPhage
+    int8_t *decisionState; //countdown to the lysis/lysogeny decision of the phage in decidingPhage
+    int8_t *multiplicityCounter; //infections by the deciding phage minus those by the others, while a decision is pending (see phageStrategy.h)
+    int16_t *clockTicks; //age of the bacterium, -1 for empty sites (see foldClock)
+    int16_t *lyticTimer; //time since the bacterium turned lytic, -1 otherwise
+    int8_t *healthyBirthTicker; //countdown to division inside the birth window of healthy cells
+    int8_t *infectedBirthTicker; //the same for lysogenic cells
+    uint8_t *infectingPhage; //phage (0 is A) trying to infect the site, while infectionStatus is not 0
+    uint8_t *decidingPhage; //phage whose decision is pending, while decisionState is not 0
+
+    CellLattice() : size(0), stride(0), cellCount(0), periodic(false), block(0), blockBytes(0), mapped(false)
+    {
+        clearPointers();
+    }
+
+    ~CellLattice()
+    {
+        release();
+    }
+
+    void allocate(long latticeSize) //(re)allocates all planes for a latticeSize x latticeSize colony and empties it
+    {
+        release();
+        long offsets[planeCount];
+        layout(latticeSize, offsets);
+        block = static_cast<char *>(aligned_alloc(cacheLineBytes, blockBytes));
+        if(!block)
+            throw std::bad_alloc();
+        setPointers(offsets);
+        clear();
+    }
+
+    //maps planes that were saved from data() at offset in the file fd, copy-on-write: pages are only read when first touched and
+    //changes never reach the file. Returns false, leaving the lattice empty, if bytes does not match the layout or mmap fails.
+    bool map(long latticeSize, int fd, long offset, long bytes)
+    {
+        release();
+        long offsets[planeCount];
+        layout(latticeSize, offsets);
+        void *mapping = (bytes == blockBytes) ? mmap(0, blockBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, offset) : MAP_FAILED;
+        if(mapping == MAP_FAILED)
+        {
+            size = stride = cellCount = blockBytes = 0;
+            return false;
+        }
+        block = static_cast<char *>(mapping);
+        mapped = true;
+        setPointers(offsets);
+        return true;
+    }
+
+    const char *data() const //all planes as one block of dataBytes() bytes, see map
+    {
+        return block;
+    }
+
+    long dataBytes() const
+    {
+        return blockBytes;
+    }
+
+    void clear() //empty lattice: no bacteria, all clocks and tickers null (-1), closed boundaries
+    {
+        memset(state, 0, cellCount);
+        setBoundary(false);
+        memset(infectionStatus, 0, cellCount);
+        memset(decisionState, 0, cellCount);
+        memset(multiplicityCounter, 0, cellCount);
+        memset(clockTicks, 0xff, cellCount*sizeof(int16_t)); //all bits set is -1 in every signed width
+        memset(lyticTimer, 0xff, cellCount*sizeof(int16_t));
+        memset(healthyBirthTicker, 0xff, cellCount);
+        memset(infectedBirthTicker, 0xff, cellCount);
+        memset(infectingPhage, 0, cellCount);
+        memset(decidingPhage, 0, cellCount);
+    }
+
+    long index(long j, long k) const //plane index of the site in row j, column k; rows and columns -1 and size are the halo
+    {
+        return (j + 1)*stride + k + 1;
+    }
+
+    long row(long i) const //row of the site with plane index i
+    {
+        return i/stride - 1;
+    }
+
+    long column(long i) const
+    {
+        return i%stride - 1;
+    }
+
+    void setBoundary(bool periodicBoundary) //fills the halo with blocked sites, or with the states of the opposite edges
+    {
+        periodic = periodicBoundary;
+        for(long k = -1; k <= size; k++)
+        {
+            state[index(-1, k)] = periodic ? state[wrap(index(-1, k))] : blockedSite;
+            state[index(size, k)] = periodic ? state[wrap(index(size, k))] : blockedSite;
+        }
+        for(long j = 0; j < size; j++)
+        {
+            state[index(j, -1)] = periodic ? state[index(j, size - 1)] : blockedSite;
+            state[index(j, size)] = periodic ? state[index(j, 0)] : blockedSite;
+        }
+    }
+
+    long wrap(long i) const //the interior site a halo site stands for with periodic boundaries; interior sites are returned unchanged
+    {
+        long j = row(i), k = column(i);
+        if(j >= 0 && j < size && k >= 0 && k < size)
+            return i;
+        j = (j + size) % size;
+        k = (k + size) % size;
+        return index(j, k);
+    }
+
+    void mirror(long i) //copies the state of interior site i to the halo sites standing for it; only needed with periodic boundaries
+    {
+        long j = row(i), k = column(i);
+        long dj = (j == 0) ? size : (j == size - 1) ? -size : 0;
+        long dk = (k == 0) ? size : (k == size - 1) ? -size : 0;
+        if(dj)
+            state[index(j + dj, k)] = state[i];
+        if(dk)
+            state[index(j, k + dk)] = state[i];
+        if(dj && dk)
+            state[index(j + dj, k + dk)] = state[i];
+    }
+
+    long bytesPerSite() const
+    {
+        long bytes = 0;
+        for(int i = 0; i < planeCount; i++)
+            bytes += planeWidth[i];
+        return bytes;
+    }
+
+private:
+    static const int planeCount = 10;
+    static constexpr long planeWidth[planeCount] = {1, 1, 1, 1, 2, 2, 1, 1, 1, 1};
+
+    char *block; //the single allocation holding every plane
+    long blockBytes;
+    bool mapped; //block comes from map rather than allocate
+
+    static long roundToCacheLine(long bytes)
+    {
+        return (bytes + cacheLineBytes - 1)/cacheLineBytes*cacheLineBytes;
+    }
+
+    void layout(long latticeSize, long offsets[planeCount]) //sets the sizes for a latticeSize x latticeSize colony and the offset of every plane in the block
+    {
+        size = latticeSize;
+        stride = latticeSize + 2;
+        cellCount = stride*(latticeSize + 2);
+        blockBytes = 0;
+        for(int i = 0; i < planeCount; i++)
+        {
+            offsets[i] = blockBytes;
+            blockBytes += roundToCacheLine(cellCount*planeWidth[i]);
+        }
+    }
+
+    void setPointers(const long offsets[planeCount])
+    {
+        state = reinterpret_cast<uint8_t *>(block + offsets[0]);
+        infectionStatus = reinterpret_cast<int8_t *>(block + offsets[1]);
+        decisionState = reinterpret_cast<int8_t *>(block + offsets[2]);
+        multiplicityCounter = reinterpret_cast<int8_t *>(block + offsets[3]);
+        clockTicks = reinterpret_cast<int16_t *>(block + offsets[4]);
+        lyticTimer = reinterpret_cast<int16_t *>(block + offsets[5]);
+        healthyBirthTicker = reinterpret_cast<int8_t *>(block + offsets[6]);
+        infectedBirthTicker = reinterpret_cast<int8_t *>(block + offsets[7]);
+        infectingPhage = reinterpret_cast<uint8_t *>(block + offsets[8]);
+        decidingPhage = reinterpret_cast<uint8_t *>(block + offsets[9]);
+    }
+
+    void clearPointers()
+    {
+        state = 0;
+        infectionStatus = 0;
+        decisionState = 0;
+        multiplicityCounter = 0;
+        clockTicks = 0;
+        lyticTimer = 0;
+        healthyBirthTicker = 0;
+        infectedBirthTicker = 0;
+        infectingPhage = 0;
+        decidingPhage = 0;
+    }
+
+    void release()
+    {
+        if(mapped)
+            munmap(block, blockBytes);
+        else
+            free(block);
+        block = 0;
+        mapped = false;
+        blockBytes = 0;
+        clearPointers();
+    }
+
+    CellLattice(const CellLattice &); //planes are owned, copying is not allowed
+    CellLattice &operator=(const CellLattice &);
+};
+
+#endif
@@ -0,0 +1,196 @@
+/////////////////////////////////////////////////////////////////////////////
+// Checkpoints of the full simulation state
+// A checkpoint holds everything needed to carry on a run exactly as if it
+// had never stopped: the tick, the population counters, the parameters
+// (which include the random seed; the random numbers only depend on seed,
+// tick and site, so there is no generator state to save) and all per-site
+// planes of the lattice. The planes are stored as the single block of
+// CellLattice, starting on a 64 KiB boundary, so resuming maps them into
+// memory copy-on-write instead of reading them: a checkpoint of any size
+// loads in a moment, and many runs forked from one checkpoint share the
+// pages they have not changed.
+//
+// The lattice is saved as the sweep would have it at the start of the tick
+// (see Simulation::synchronise), so a checkpoint does not depend on the
+// engine and can be resumed with any of them.
+//
+// File layout (little-endian):
+//   char     magic[8]        "PHAGECK\0"
+//   uint32   version         4 (3 had 16-bit decision and multiplicity planes, 2 only counted phages A and B, 1 had no halo around the lattice planes)
+//   uint32   parameterBytes  length of the parameter text below
+//   int64    tick            first tick still to be simulated
+//   int64    latticeSize
+//   int64    blockOffset     where the planes start
+//   int64    blockBytes
+//   int64    seriesBytes     length of the time series file at this tick, for --resume
+//   int64    counts[18]      bacteria, deaths, then lysogenic and lytic for every phage A to H
+//   char     parameters[]    SimulationParameters::describe()
+/////////////////////////////////////////////////////////////////////////////
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+#include <vector>
+#include "phageSimulation.h"
+
+class Checkpoint
+{
+public:
+    SimulationParameters params; //parameters the checkpointed run was using
+    long tick;
+    PopulationCounts population;
+    long seriesBytes;
+
+    Checkpoint() : tick(0), population(), seriesBytes(0), fd(-1), blockOffset(0), blockBytes(0) {}
+
+    ~Checkpoint()
+    {
+        if(fd != -1)
+            ::close(fd);
+    }
+
+    //saves sim at the start of tick t, writing to a temporary file that replaces fileName once it is complete; false on any error
+    static bool write(const std::string &fileName, Simulation &sim, long t, long seriesBytes = 0)
+    {
+        sim.synchronise(t);
+        std::string parameters = sim.params.describe();
+        Header header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, magic, 8);
+        header.version = version;
+        header.parameterBytes = parameters.size();
+        header.tick = t;
+        header.latticeSize = sim.cells.size;
+        header.blockOffset = (sizeof(header) + parameters.size() + blockAlignment - 1)/blockAlignment*blockAlignment;
+        header.blockBytes = sim.cells.dataBytes();
+        header.seriesBytes = seriesBytes;
+        const PopulationCounts &p = sim.population;
+        header.counts[0] = p.bacteriaCount;
+        header.counts[1] = p.deathCount;
+        for(int phage = 0; phage < maxPhageCount; phage++)
+        {
+            header.counts[2 + 2*phage] = p.lysogenicBacteriaCount[phage];
+            header.counts[3 + 2*phage] = p.lyticBacteriaCount[phage];
+        }
+
+        std::string temporary = fileName + ".tmp";
+        FILE *file = fopen(temporary.c_str(), "wb");
+        if(!file)
+            return false;
+        std::vector<char> padding(header.blockOffset - sizeof(header) - parameters.size(), 0);
+        bool ok = fwrite(&header, sizeof(header), 1, file) == 1 && fwrite(parameters.data(), 1, parameters.size(), file) == parameters.size()
+               && fwrite(&padding[0], 1, padding.size(), file) == padding.size()
+               && fwrite(sim.cells.data(), 1, header.blockBytes, file) == (size_t)header.blockBytes;
+        ok = (fclose(file) == 0) && ok;
+        ok = ok && rename(temporary.c_str(), fileName.c_str()) == 0;
+        if(!ok)
+            remove(temporary.c_str());
+        return ok;
+    }
+
+    std::string open(const std::string &fileName) //reads the header and parameters; returns what is wrong with the file, or an empty string
+    {
+        if(fd != -1)
+            ::close(fd);
+        fd = ::open(fileName.c_str(), O_RDONLY);
+        if(fd == -1)
+            return "Cannot open " + fileName + ".";
+        Header header;
+        if(pread(fd, &header, sizeof(header), 0) != (ssize_t)sizeof(header) || memcmp(header.magic, magic, 8) != 0)
+            return fileName + " is not a checkpoint.";
+        if(header.version != version)
+            return fileName + " is a checkpoint of another version.";
+        std::string parameters(header.parameterBytes, '\0');
+        if(pread(fd, &parameters[0], parameters.size(), sizeof(header)) != (ssize_t)parameters.size())
+            return fileName + " is cut short.";
+        std::istringstream lines(parameters);
+        std::string line;
+        params = SimulationParameters();
+        while(getline(lines, line))
+        {
+            size_t equals = line.find('=');
+            if(equals == std::string::npos || !params.set(line.substr(0, equals), line.substr(equals + 1)))
+                return fileName + " has an unknown parameter: " + line;
+        }
+        if(params.latticeSize != header.latticeSize)
+            return fileName + " is damaged.";
+        off_t fileBytes = lseek(fd, 0, SEEK_END);
+        if(fileBytes < header.blockOffset + header.blockBytes)
+            return fileName + " is cut short.";
+        tick = header.tick;
+        population.bacteriaCount = header.counts[0];
+        population.deathCount = header.counts[1];
+        for(int phage = 0; phage < maxPhageCount; phage++)
+        {
+            population.lysogenicBacteriaCount[phage] = header.counts[2 + 2*phage];
+            population.lyticBacteriaCount[phage] = header.counts[3 + 2*phage];
+        }
+        seriesBytes = header.seriesBytes;
+        blockOffset = header.blockOffset;
+        blockBytes = header.blockBytes;
+        return "";
+    }
+
+    //maps the saved lattice into sim, which must have been created for the same lattice size, and carries on from the saved tick.
+    //The parameters of sim may differ from params (forking variants from one colony). Can be called for any number of simulations.
+    std::string restore(Simulation &sim) const
+    {
+        std::string error = forkError(sim.params);
+        if(!error.empty())
+            return error;
+        if(!sim.cells.map(params.latticeSize, fd, blockOffset, blockBytes))
+            return "The checkpoint lattice cannot be mapped.";
+        sim.resumeFrom(tick, population);
+        return "";
+    }
+
+    //why a run with parameters p cannot start from this checkpoint, or an empty string if it can. The saved clocks of bacteria
+    //past every death time were folded with the saved parameters (see Simulation::clockFoldPeriod): they only keep their age
+    //modulo the old fold period, and the fold window they sit in is also reached by younger clocks. A fork can therefore not
+    //have a later last death time, which such a clock might reach, nor a fold period that does not divide the old one.
+    std::string forkError(const SimulationParameters &p) const
+    {
+        if(p.latticeSize != params.latticeSize)
+            return "The checkpoint is for a lattice of " + std::to_string(params.latticeSize) + " sites per side.";
+        if(p.phageCount < params.phageCount)
+            return "The checkpoint has " + std::to_string(params.phageCount) + " phages.";
+        int lastDeath = params.clockFoldLimit() - params.clockFoldPeriod() - 1;
+        if(p.clockFoldLimit() - p.clockFoldPeriod() - 1 > lastDeath || params.clockFoldPeriod() % p.clockFoldPeriod())
+            return "The checkpoint folded the clocks past its last death time " + std::to_string(lastDeath) + " with period " + std::to_string(params.clockFoldPeriod()) +
+                   "; no death time can be later and the common multiple of the growth rates must divide that period.";
+        return "";
+    }
+
+private:
+    struct Header
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t parameterBytes;
+        int64_t tick;
+        int64_t latticeSize;
+        int64_t blockOffset;
+        int64_t blockBytes;
+        int64_t seriesBytes;
+        int64_t counts[2 + 2*maxPhageCount];
+    };
+
+    static constexpr char magic[8] = "PHAGECK";
+    static const uint32_t version = 4;
+    static const long blockAlignment = 65536; //a multiple of the page size on every common system, as mmap requires
+
+    int fd;
+    long blockOffset;
+    long blockBytes;
+
+    Checkpoint(const Checkpoint &);
+    Checkpoint &operator=(const Checkpoint &);
+};
+
+#endif
@@ -0,0 +1,89 @@
+/////////////////////////////////////////////////////////////////////////////
+// Counter-based random numbers (Philox4x32-10, Salmon et al. 2011)
+// A random number is a pure function of (seed, tick, site, draw index):
+// the 128-bit counter (tick, site, block) is encrypted with the 64-bit seed
+// as key, giving four independent 32-bit numbers per block. Nothing is
+// carried over from one draw to the next, so the numbers a bacterium gets
+// do not depend on the order in which the lattice is swept or on which
+// thread visits it.
+//
+// block() computes the four numbers of one (tick, site) pair; fill() does
+// the same for a run of consecutive sites in one branch-free loop that the
+// compiler can vectorise, writing the result lane by lane (planar).
+/////////////////////////////////////////////////////////////////////////////
+#ifndef COUNTER_RANDOM_H
+#define COUNTER_RANDOM_H
+
+#include <cstdint>
+
+class CounterRandom
+{
+public:
+    explicit CounterRandom(uint64_t seed = 0) : key0((uint32_t)seed), key1((uint32_t)(seed >> 32)) {}
+
+    void block(long tick, long site, uint32_t out[4], uint32_t blockIndex = 0) const //the four numbers of block blockIndex for site in tick
+    {
+        uint32_t c0, c1, c2, c3;
+        counter(tick, site, blockIndex, c0, c1, c2, c3);
+        philox(c0, c1, c2, c3);
+        out[0] = c0;
+        out[1] = c1;
+        out[2] = c2;
+        out[3] = c3;
+    }
+
+    void fill(long tick, long firstSite, long count, uint32_t *out, uint32_t blockIndex = 0) const //block() for count consecutive sites; lane l of site firstSite + n goes to out[l*count + n]
+    {
+        for(long n = 0; n < count; n++)
+        {
+            uint32_t c0, c1, c2, c3;
+            counter(tick, firstSite + n, blockIndex, c0, c1, c2, c3);
+            philox(c0, c1, c2, c3);
+            out[n] = c0;
+            out[count + n] = c1;
+            out[2*count + n] = c2;
+            out[3*count + n] = c3;
+        }
+    }
+
+    static bool bernoulli(uint32_t number, double probability) //true with the given probability, at 2^-32 resolution
+    {
+        return number < probability*4294967296.0;
+    }
+
+    static uint32_t below(uint32_t number, uint32_t n) //integer uniformly distributed in 0..n-1 (bias below 2^-32 * n)
+    {
+        return (uint32_t)(((uint64_t)number*n) >> 32);
+    }
+
+private:
+    uint32_t key0, key1;
+
+    static void counter(long tick, long site, uint32_t blockIndex, uint32_t &c0, uint32_t &c1, uint32_t &c2, uint32_t &c3)
+    {
+        c0 = (uint32_t)tick;
+        c1 = (uint32_t)site;
+        c2 = (uint32_t)((uint64_t)tick >> 32) ^ ((uint32_t)((uint64_t)site >> 32) << 16);
+        c3 = blockIndex;
+    }
+
+    void philox(uint32_t &c0, uint32_t &c1, uint32_t &c2, uint32_t &c3) const
+    {
+        uint32_t k0 = key0, k1 = key1;
+        for(int round = 0; round < 10; round++)
+        {
+            uint64_t product0 = (uint64_t)0xD2511F53u*c0;
+            uint64_t product1 = (uint64_t)0xCD9E8D57u*c2;
+            uint32_t next0 = (uint32_t)(product1 >> 32) ^ c1 ^ k0;
+            uint32_t next2 = (uint32_t)(product0 >> 32) ^ c3 ^ k1;
+            c1 = (uint32_t)product1;
+            c3 = (uint32_t)product0;
+            c0 = next0;
+            c2 = next2;
+            k0 += 0x9E3779B9u;
+            k1 += 0xBB67AE85u;
+        }
+    }
+};
+
+#endif
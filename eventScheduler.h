@@ -0,0 +1,102 @@
+/////////////////////////////////////////////////////////////////////////////
+// Timing wheel for the event-driven engine
+// Instead of visiting every bacterium on every tick, each site is scheduled
+// for the next tick at which its update could do anything (die, burst,
+// try an infection, decide, draw a birth time or divide). Visits scheduled
+// for the same tick are handed out in increasing site order, and sites
+// woken up by a neighbour are slotted in behind the current one, so the
+// sites are processed in exactly the order of the row-major sweep.
+//
+// The wheel holds one bucket per tick modulo its size, which must exceed
+// the furthest any event can be scheduled ahead (the scheduling horizon).
+// A site is only ever scheduled once: scheduledAt remembers the pending
+// visit, and bucket entries that no longer match it are stale and skipped.
+/////////////////////////////////////////////////////////////////////////////
+#ifndef EVENT_SCHEDULER_H
+#define EVENT_SCHEDULER_H
+
+#include <cstdint>
+#include <vector>
+#include "siteBitmap.h"
+
+class EventScheduler
+{
+public:
+    std::vector<int32_t> lastVisit; //last tick whose clock pass has been applied to each site (see catchUpSite)
+
+    EventScheduler() : mask(0), currentTick(-1), currentSite(-1) {}
+
+    void resize(long siteCount, long horizon) //clears all schedules; events may later be scheduled up to horizon ticks ahead
+    {
+        long slots = 1;
+        while(slots <= horizon)
+            slots *= 2;
+        buckets.assign(slots, std::vector<long>());
+        mask = slots - 1;
+        scheduledAt.assign(siteCount, -1);
+        lastVisit.assign(siteCount, -1);
+        dueNow.resize(siteCount);
+        currentTick = -1;
+        currentSite = -1;
+    }
+
+    void schedule(long site, long tick) //asks for a visit of site at tick, unless an earlier visit is already pending
+    {
+        if(scheduledAt[site] != -1 && scheduledAt[site] <= tick)
+            return;
+        scheduledAt[site] = tick;
+        buckets[tick & mask].push_back(site);
+    }
+
+    void wake(long site) //visits site as soon as the sweep order allows: later in this tick if it lies ahead of the current site, otherwise next tick
+    {
+        if(currentSite != -1 && site > currentSite)
+        {
+            scheduledAt[site] = currentTick;
+            dueNow.insert(site);
+        }
+        else
+            schedule(site, currentTick + 1);
+    }
+
+    bool beginTick(long t) //collects the visits due at tick t; returns false if there are none
+    {
+        currentTick = t;
+        currentSite = -1;
+        std::vector<long> &bucket = buckets[t & mask];
+        for(size_t n = 0; n < bucket.size(); n++)
+            if(scheduledAt[bucket[n]] == t)
+                dueNow.insert(bucket[n]);
+        bucket.clear();
+        return dueNow.size() > 0;
+    }
+
+    long nextSite() //hands out the next site due in the current tick, in increasing order, or -1 once the tick is done
+    {
+        long site = dueNow.next(currentSite + 1);
+        if(site == -1)
+        {
+            currentSite = -1;
+            return -1;
+        }
+        dueNow.erase(site);
+        scheduledAt[site] = -1;
+        currentSite = site;
+        return site;
+    }
+
+    long tick() const
+    {
+        return currentTick;
+    }
+
+private:
+    std::vector<std::vector<long> > buckets; //buckets[t & mask] lists the sites scheduled for tick t
+    long mask;
+    std::vector<int32_t> scheduledAt; //tick of the pending visit of each site, -1 if there is none; ticks fit 32 bits (see SimulationParameters::check)
+    SiteBitmap dueNow; //sites still to be visited in the current tick
+    long currentTick;
+    long currentSite; //site being visited, -1 between visits of different ticks
+};
+
+#endif
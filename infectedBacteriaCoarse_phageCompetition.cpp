@@ -7,6 +7,50 @@
 // Bacteria collect damage every clock tick, and the mother retains damage
 // upon binary fission. They die after after a threshold damage
 // has been accumulated. Results are stored in "infectedResults.csv"
+//
+// Usage: infectedBacteriaCoarse_phageCompetition [--size N] [--time T] [--engine E] [--threads N] [--tile N] [--seed S] [--periodic] [--output csv|binary] [--every N] [--on-change] [--snapshots K] [--keyframes N] [--spatial K] [--correlations R] [--checkpoint N] [--resume F | --fork F] [--set name=value]...
+//        infectedBacteriaCoarse_phageCompetition --sweep config
+//   --size N     side of the square lattice (default 40)
+//   --time T     number of clock ticks to simulate (default 200000)
+//   --engine E   active: visit only occupied sites (default)
+//                sweep: visit every site of the lattice twice per tick, as the original code did
+//                event: visit a bacterium only on the ticks where something happens to it
+//                parallel: update the lattice tile by tile on --threads threads (see parallelTick)
+//   --threads N  worker threads of the parallel engine (default: all hardware threads)
+//   --tile N     side of the tiles of the parallel engine (default 64, at least 2)
+//   --seed S     seed of the random numbers (default 10)
+//   --periodic   the lattice wraps around at its edges instead of being closed (same as --set periodicBoundary=1);
+//                with the parallel engine the number of tiles per side must then be even and the last tile at least
+//                2 sites wide
+//   --output F   csv: infectedResults.csv (default); binary: infectedResults.bin, fixed-width int32 rows (see timeSeriesWriter.h)
+//   --every N    only write every N-th tick (default 1)
+//   --on-change  only write ticks where a count changed
+//   --snapshots K  also write the lattice every K ticks to infectedSnapshots.snap, compressed (see snapshotStream.h
+//                  and snapshotReader.cpp)
+//   --keyframes N  frames between two full frames of the snapshot stream (default 64)
+//   --spatial K  also write statistics of the lysogen domains every K ticks, and at the end, to infectedSpatial.csv:
+//                number and sizes of the domains of every phage, interface lengths and pair correlations, updated
+//                tick by tick from the changes (see spatialStatistics.h)
+//   --correlations R  largest distance of the pair correlations (default 8)
+//   --checkpoint N  saves the whole state every N ticks to infectedCheckpoint.ckpt (see checkpoint.h)
+//   --resume F   carries on the run saved in checkpoint F, with its parameters, continuing its infectedResults file
+//                (give the same --output options); snapshots go to infectedSnapshots_<tick>.snap and spatial
+//                statistics to infectedSpatial_<tick>.csv
+//   --fork F     starts from the colony saved in F with new output files; --set can change any parameter but the lattice size,
+//                within the limits the saved clocks set on death times and growth rates (see Checkpoint::forkError)
+//   --set name=value  sets any other parameter of SimulationParameters (phageSimulation.h), e.g. --set probInfectionA=0.3;
+//                     --set phageCount=N lets N phages compete (at most 8, A to H) and --set strategyC=threshold2 picks the
+//                     lysogeny strategy of one of them (see phageStrategy.h)
+//   --sweep config    runs the parameter grid and replicates of config in this process and writes one summary line
+//                     per run instead of infectedResults.csv (see parameterSweep.h)
+//   The run stops at --time, or earlier when a stopping criterion set with --set is met (see runTermination.h):
+//   stopAtSurvivors=N once at most N phages are left, plateauWindow=W and plateauTolerance=f once the counts stay
+//   flat over W ticks, wallClockBudget=S after S seconds. The last line printed tells the tick and the reason.
+//   Built with -DPHAGE_PROFILE, the run also writes infectedProfile.csv: the CPU cycles of every phase of the update and
+//   counts of visits, births, deaths, bursts, infections and decisions (see phaseProfiler.h).
+//   The active, sweep and event engines produce the same trajectory. The parallel engine visits the
+//   sites in a different order, so its trajectory differs from theirs, but it is the same for any
+//   number of threads. Random numbers are keyed by (seed, tick, site), see counterRandom.h.
 /////////////////////////////////////////////////////////////////////////////
 #include <iostream>
 // #include <conio.h>
@@ -15,431 +59,229 @@
 #include <stdio.h>
 #include <cstdlib>
 #include <time.h>
+#include <string>
 #include <fstream>
+#include "phageSimulation.h"
+#include "parameterSweep.h"
+#include "snapshotStream.h"
+#include "checkpoint.h"
 
 using namespace std;
 
 ///////////////////////////////////////////////////////////////////////
 // Parameters
 //////////////////////////////////////////////////////////////////////
-const int healthyGrowthRate = 20; //setting growth rate to one fission every 20 cycles of the internal clock of the bacterium
-const int lysogenicGrowthRateA = 30; //7 //division time for infected bacteria
-const int lysogenicGrowthRateB = 30;
-const int healthyDeathTime = 150; //15 //healthy bacteria die every healthyDeathTime units
-const int lysogenicDeathTimeA = 120; //22
-const int lysogenicDeathTimeB = 120;
-const int lysisBurstTimeA = 1000; //time (after infection) after which an infected lytic bacterium bursts
-const int lysisBurstTimeB = 1000;
-const float probInfectionA = 0.4; //6 //probability of infection per burst in bacterial vicinity
-const float probInfectionB = 0.4;
-const int decisionTime = 30; //time during which bacterium makes decision
-const int birthTimeRange = 2; //+- values of time for which birth can occur
-const int numberOfTriesA = 3;
-const int numberOfTriesB = 3;
-long bacteriaCount = 0; //counters keeping track of the numbers
-const long latticeSize = 40;
-long lysogenicBacteriaCountA = 0;
-long lysogenicBacteriaCountB = 0;
-long lyticBacteriaCountA = 0;
-long lyticBacteriaCountB = 0;
-long deathCount = 0; //counts number of dead bacteria
-long maxTime = 200000;
+//the model parameters are in SimulationParameters (phageSimulation.h); their defaults are the values of the paper
+SimulationParameters parameters;
+Engine engine = activeEngine; //chosen with --engine
+int threadCount = ThreadPool::hardwareThreads();
+long tileSize = 64;
+TimeSeriesWriter results; //file storing the results
+SeriesFormat resultsFormat = csvSeries; //chosen with --output
+long resultsEvery = 1;
+bool resultsOnChange = false;
+SnapshotWriter snapshots; //lattice snapshots, written if --snapshots is given
+long snapshotEvery = 0;
+long snapshotKeyframes = 64;
+long spatialEvery = 0; //0 for no spatial statistics
+int correlationRange = defaultCorrelationRange;
+ofstream spatialResults; //spatial statistics, written if --spatial is given
+long spatialLastRow = -1; //tick of the last row written to spatialResults
+long checkpointEvery = 0; //0 for no checkpoints
+Checkpoint startingPoint; //checkpoint given with --resume or --fork
 
-///////////////////////////////////////////////////////////////////////
-// Matrices
-//////////////////////////////////////////////////////////////////////
-long lattice[latticeSize][latticeSize] = {0}; //stores the status of each cell. 0: empty; 1: healthy; 2: lysogenic; 3: lytic
-long infectionStatus[latticeSize][latticeSize] = {0}; //stores the infection counter for each healthy bacterium (see infectionThreshold)
-long clockTicks[latticeSize][latticeSize]; //stores the age of each bacterium; acts as an internal clock
-long lyticTimer[latticeSize][latticeSize];
-long decisionState[latticeSize][latticeSize] = {0};
-long multiplicityCounter[latticeSize][latticeSize]; //multiplicity of infection counter for each bacterium in decisionState 1
-int allowed[4] = {0}; //keeps track of the free spots in the neighbourhood of each bacterium, where 0 is the top, and the numbers increase clockwise (in a plus shape)
-int randomBox[4] = {-1, -1, -1, -1}; //array used to keep track of indices of allowed to which cell division is allowed
-long healthyBirthTicker[latticeSize][latticeSize]; //keeps track of the random birth time around the division age for each healthy cell
-long infectedBirthTicker[latticeSize][latticeSize]; //does the same as healthyBirthTicker, but for infected cells
-ofstream results; //file storing the results
-int p;
-
-void reinitAllowed() //resets the value of allowed and randomBox every time a new bacterium is moved to
+int main(int argc, char *argv[])
 {
-    for(int i = 0; i < 4; i++)
+    string sweepFile;
+    string checkpointFile;
+    bool resuming = false;
+    for(int i = 1; i + 1 < argc; i++) //the parameters saved in a checkpoint are the defaults for the other options
+        if(string(argv[i]) == "--resume" || string(argv[i]) == "--fork")
+        {
+            resuming = string(argv[i]) == "--resume";
+            checkpointFile = argv[i+1];
+            string error = startingPoint.open(checkpointFile);
+            if(!error.empty())
+            {
+                cerr << error << endl;
+                return 1;
+            }
+            parameters = startingPoint.params;
+        }
+    for(int i = 1; i < argc; i++)
     {
-        allowed[i] = 0;
-        randomBox[i] = -1;
-    }
-}
-
-///////////////////////////////////////////////////////////////////////
-// Function prototypes
-//////////////////////////////////////////////////////////////////////
-void displayLattice(long);
-void decideProgenySpot(int, long &, long &, long, long, int &);
-int countFreeSpots(long &, long &);
-//int countInfectors(long &, long &);
-void generateBacterium(int, long, long);
-void generateIsland(long, long, int);
-void beginInfectionStageA(long, long);
-void makeDecisionA(long, long);
-void beginInfectionStageB(long, long);
-void makeDecisionB(long, long);
-
-int main()
-{
-    srand(10);
-    //setting all clocks and tickers to null (-1)
-    for(long x = 0; x < latticeSize; x++)
-        for(long y = 0; y < latticeSize; y++)
+        string option = argv[i];
+        string value = (i + 1 < argc) ? argv[i+1] : "";
+        size_t equals = value.find('=');
+        if(option == "--size" && i + 1 < argc)
+            parameters.latticeSize = atol(argv[++i]);
+        else if(option == "--time" && i + 1 < argc)
+            parameters.maxTime = atol(argv[++i]);
+        else if(option == "--engine" && i + 1 < argc && parseEngine(value, engine))
+            i++;
+        else if(option == "--threads" && i + 1 < argc)
+            threadCount = atoi(argv[++i]);
+        else if(option == "--tile" && i + 1 < argc)
+            tileSize = atol(argv[++i]);
+        else if(option == "--seed" && i + 1 < argc)
+            parameters.randomSeed = strtoul(argv[++i], 0, 10);
+        else if(option == "--periodic")
+            parameters.periodicBoundary = true;
+        else if(option == "--output" && value == "csv")
+        {   resultsFormat = csvSeries; i++;    }
+        else if(option == "--output" && value == "binary")
+        {   resultsFormat = binarySeries; i++;    }
+        else if(option == "--every" && i + 1 < argc)
+            resultsEvery = atol(argv[++i]);
+        else if(option == "--on-change")
+            resultsOnChange = true;
+        else if(option == "--snapshots" && i + 1 < argc)
+            snapshotEvery = atol(argv[++i]);
+        else if(option == "--keyframes" && i + 1 < argc)
+            snapshotKeyframes = atol(argv[++i]);
+        else if(option == "--spatial" && i + 1 < argc)
+            spatialEvery = atol(argv[++i]);
+        else if(option == "--correlations" && i + 1 < argc)
+            correlationRange = atoi(argv[++i]);
+        else if(option == "--checkpoint" && i + 1 < argc)
+            checkpointEvery = atol(argv[++i]);
+        else if((option == "--resume" || option == "--fork") && i + 1 < argc)
+            i++;
+        else if(option == "--set" && equals != string::npos && parameters.set(value.substr(0, equals), value.substr(equals + 1)))
+            i++;
+        else if(option == "--sweep" && i + 1 < argc)
+            sweepFile = argv[++i];
+        else
         {
-            clockTicks[x][y] = -1;
-            healthyBirthTicker[x][y] = -1;
-            infectedBirthTicker[x][y] = -1;
-            lyticTimer[x][y] = -1;
+            cerr << "Usage: " << argv[0] << " [--size N] [--time T] [--engine active|sweep|event|parallel] [--threads N] [--tile N] [--seed S] [--periodic] [--output csv|binary] [--every N] [--on-change] [--snapshots K] [--keyframes N] [--spatial K] [--correlations R] [--checkpoint N] [--resume F | --fork F] [--set name=value]..." << endl;
+            cerr << "       " << argv[0] << " --sweep config" << endl;
+            return 1;
         }
+    }
 
-    //opening the results file and prepping it up
-    results.open("infectedResults.csv", ios::out);
-    results << "t,bacteriaCount,lysogenicBacteriaCountA,lyticBacteriaCountA,lysogenicBacteriaCountB,lyticBacteriaCountB,healthyBacteriaCount\n";
-
-    ////////////////////////////////////////////////////////////////////////////////////
-    // Initial conditions
-    ////////////////////////////////////////////////////////////////////////////////////
-    // 0 represents free spot, 1 represents healthy bacterium, 2 represents infected bacterium
-    //generateIsland creates an island with an infected bacterium flanked by 4 healthy ones on an x shape centered at (x,y)
-    generateIsland(latticeSize/4, latticeSize/4, 5);
-    generateIsland(3*latticeSize/4, 3*latticeSize/4, 3);
-    //generateIsland(latticeSize/4, 3*latticeSize/4, 1);
-    //generateIsland(3*latticeSize/4, latticeSize/4, 1);
-
-    for(long t = 0; t < maxTime || bacteriaCount == pow(latticeSize, 2); t++)
+    if(!sweepFile.empty())
     {
-        //srand(time(NULL));
-        displayLattice(t); //Sleep(20000000000); //<-- I use sleep to pause the program and check some things randomly
-        for(long x = 0; x < latticeSize; x++) //increment internal clocks for each bacterium, decrementing the birth tickers for each time step
-            for(long y = 0; y < latticeSize; y++)
-            {
-                if(clockTicks[x][y] != -1)
-                    clockTicks[x][y]++;
-                if(healthyBirthTicker[x][y] >= 0)
-                    healthyBirthTicker[x][y] -= 1;
-                if(infectedBirthTicker[x][y] >= 0)
-                    infectedBirthTicker[x][y] -= 1;
-                if(lyticTimer[x][y] != -1)
-                    lyticTimer[x][y]++;
-            }
-
-        //sweeping through the lattice
-        for(long j = 0; j < latticeSize; j++)
-        {for(long k = 0; k < latticeSize; k++)
-            {
-                if(lattice[j][k]) //looking for a non-empty site
-                {
-                    //making sure the ticker for the bacterium hasn't gone below -1
-                    if(healthyBirthTicker[j][k] < -1)
-                        healthyBirthTicker[j][k] = -1;
-                    if(infectedBirthTicker[j][k] < -1)
-                        infectedBirthTicker[j][k] = -1;
-
-                    //this loop kills things if their time has come
-                    if((clockTicks[j][k] == healthyDeathTime && lattice[j][k] == 1) || (clockTicks[j][k] == lysogenicDeathTimeA && lattice[j][k] == 2) || (clockTicks[j][k] == lysogenicDeathTimeB && lattice[j][k] == 4) || (lyticTimer[j][k] == lysisBurstTimeA && lattice[j][k] == 3) || (lyticTimer[j][k] == lysisBurstTimeB && lattice[j][k] == 5))
-                    {
-                        if(lattice[j][k] == 2)
-                            lysogenicBacteriaCountA--;
-                        else if(lattice[j][k] == 4)
-                            lysogenicBacteriaCountB--;
-                        else if(lattice[j][k] == 3)
-                        {
-                            lyticBacteriaCountA--;
-                            beginInfectionStageA(j, k);
-                        }
-                        else if(lattice[j][k] == 5)
-                        {
-                            lyticBacteriaCountB--;
-                            beginInfectionStageB(j, k);
-                        }
-                        lattice[j][k] = 0; //resetting all counters and stuff here
-                        clockTicks[j][k] = -1;
-                        healthyBirthTicker[j][k] = -1;
-                        infectedBirthTicker[j][k] = -1;
-                        multiplicityCounter[j][k] = 0;
-                        infectionStatus[j][k] = 0;
-                        decisionState[j][k] = 0;
-                        bacteriaCount--;
-                        deathCount++;
-                        continue; //continue skips the rest of this iteration and begins the next one for this main for loop immediately
-                    }
-
-                    if(lattice[j][k] == 1)
-                    {
-                        if(infectionStatus[j][k] > 0) //negative infectionStatus implies infection from B phage, and positive, by A phage
-                        {
-                            p = rand() % 100;
-                            if(p < (probInfectionA*100))
-                            {
-                                multiplicityCounter[j][k]++;
-                                if(!decisionState[j][k])
-                                    decisionState[j][k] = decisionTime;
-                            }
-                            infectionStatus[j][k]--;
-                        }
-                        else if(infectionStatus[j][k] < 0)
-                        {
-                            p = rand() % 100;
-                            if(p < (probInfectionB*100))
-                            {
-                                multiplicityCounter[j][k]--;
-                                if(!decisionState[j][k])
-                                    decisionState[j][k] = -decisionTime;
-                            }
-                            infectionStatus[j][k]++;
-                        }
-
-                        if(decisionState[j][k] > 0) //again, positive decisionState implies decision via strategy A
-                        {
-                            decisionState[j][k]--;
-                            if(!decisionState[j][k])
-                                makeDecisionA(j, k);
-                        }
-                        else if(decisionState[j][k] < 0)
-                        {
-                            decisionState[j][k]++;
-                            if(!decisionState[j][k])
-                                makeDecisionB(j, k);
-                        }
-                    }
-
-                    //choosing random times for cell division if the current clock of the cell reads a time just within the division age (so at 25 if the division age is 30 and the range is 5)
-                    //srand(time(NULL)); //seeding the random number generator with the system time
-                    if((healthyBirthTicker[j][k] == -1) && (clockTicks[j][k] != 0) && (clockTicks[j][k] % healthyGrowthRate == (healthyGrowthRate - birthTimeRange)) && lattice[j][k] == 1)
-                        healthyBirthTicker[j][k] = rand() % (birthTimeRange*2 + 1); //rand() generates a random integer between 0 and whatever number is after the % sign (except that number itself)
-
-                    //srand(time(NULL));
-                    if((infectedBirthTicker[j][k] == -1) && (clockTicks[j][k] != 0) && (((clockTicks[j][k] % lysogenicGrowthRateA == (lysogenicGrowthRateA - birthTimeRange)) && lattice[j][k] == 2) || ((clockTicks[j][k] % lysogenicGrowthRateB == (lysogenicGrowthRateB - birthTimeRange)) && lattice[j][k] == 4)))
-                        infectedBirthTicker[j][k] = rand() % (birthTimeRange*2 + 1);
-
-                    //loop checks if the growth age for the cell has been reached and initiates cell division; clockTicks[j][k] != 0 makes sure newly-born bacteria can't pass this check
-                    if(((healthyBirthTicker[j][k] == 0 && lattice[j][k] == 1) || (infectedBirthTicker[j][k] == 0 && (lattice[j][k] == 2 || lattice[j][k] == 4)) && clockTicks[j][k] != 0 && !infectionStatus[j][k] && !decisionState[j][k]))
-                    {
-                        long row, col; //keeps track of where the daughter should be placed
-                        int flag = 0; //used in case of no free spots
-                        int dice; //dice and tempDice are random variables that choose the division spot
-                        int tempDice;
-                        do
-                        {
-                            //srand(time(NULL)); //seeding the random number generator with the system time
-                            if(countFreeSpots(j, k) == 0) //if no free spots
-                            {   tempDice = -1; break;    } //break comes out of the loop
-                            int boxCount = 0; //keeps the index of the traversal through randomBox
-                            for(int index = 0; index < 4; index++)
-                                if(allowed[index]) //allowed[index] is 1 if the index position is free (0 is top, 1 is right, 2 is bottom, 3 is left)
-                                    randomBox[boxCount++] = index;
-                            tempDice = randomBox[rand() % (boxCount)]; //picking out a random position from the free location indices stored in randomBox
-                            break;
-                        }while(tempDice != -1);
-                        reinitAllowed();
-                        dice = tempDice;
-
-                        decideProgenySpot(dice, row, col, j, k, flag); //fixes values of row and col based on the position chosen by dice
-
-                        if(!lattice[row][col] && !flag) //places progeny if free spots are available (!a is equivalent to a == 0)
-                        {
-                            lattice[row][col] = lattice[j][k];
-                            clockTicks[row][col] = 0; //setting clock of the newborn to 0
-                            bacteriaCount++;
-                            healthyBirthTicker[row][col] = -1;
-                            infectedBirthTicker[row][col] = -1;
-                            if(lattice[row][col] == 2)
-                                lysogenicBacteriaCountA++;
-                            else if(lattice[row][col] == 4)
-                                lysogenicBacteriaCountB++;
-                            //displayLattice(t);
-                        }
-                    }
-                }
-            }
+        ParameterSweep sweep;
+        string error = sweep.load(sweepFile);
+        if(!error.empty())
+        {
+            cerr << error << endl;
+            return 1;
+        }
+        cout << "Running " << sweep.gridPoints() << " grid points x " << sweep.replicates << " replicates on " << sweep.threads << " threads." << endl;
+        if(!sweep.run())
+        {
+            cerr << "Could not write all of " << sweep.output << " and the per-run files." << endl;
+            return 1;
         }
+        cout << endl << "Sweep complete.";
+        return 0;
     }
-    cout << endl << "Simulation complete.";
-    results.close();
-    exit(0);
-    // getch();
-}
 
-void generateBacterium(int type, long relativePosX, long relativePosY)
-{
-    lattice[latticeSize/2 + relativePosX][latticeSize/2 + relativePosY] = type;
-    clockTicks[latticeSize/2 + relativePosX][latticeSize/2 + relativePosY] = 0;
-    bacteriaCount++;
-    if(type == 2)
-        lysogenicBacteriaCountA++;
-    if(type == 4)
-        lysogenicBacteriaCountB++;
-    if(type == 3)
+    string error = parameters.check();
+    if(!error.empty())
     {
-        lyticBacteriaCountA++;
-        lyticTimer[latticeSize/2 + relativePosX][latticeSize/2 + relativePosY] = 0;
+        cerr << error << endl;
+        return 1;
     }
-    if(type == 5)
+    if(tileSize < 2 || threadCount < 1)
     {
-        lyticBacteriaCountB++;
-        lyticTimer[latticeSize/2 + relativePosX][latticeSize/2 + relativePosY] = 0;
+        cerr << "Tiles need at least 2 sites per side and at least one thread is needed." << endl;
+        return 1;
     }
-}
-
-void generateIsland(long centerX, long centerY, int centerType)
-{
-    generateBacterium(centerType, centerX - latticeSize/2, centerY - latticeSize/2);
-    generateBacterium(1, centerX - latticeSize/2 - 1, centerY - latticeSize/2 - 1);
-    generateBacterium(1, centerX - latticeSize/2 - 1, centerY - latticeSize/2 + 1);
-    generateBacterium(1, centerX - latticeSize/2 + 1, centerY - latticeSize/2 - 1);
-    generateBacterium(1, centerX - latticeSize/2 + 1, centerY - latticeSize/2 + 1);
-}
-
-void displayLattice(long t) //prints the lattice to the screen and stores the data point in the results file
-{
-    /*system("cls");
-    for(long y = 0; y < latticeSize; y++)
+    long tilesPerSide = (parameters.latticeSize + tileSize - 1)/tileSize;
+    if(engine == parallelEngine && parameters.periodicBoundary && tilesPerSide > 1 && (tilesPerSide % 2 || parameters.latticeSize % tileSize == 1))
     {
-        cout << endl;
-        for(long x = 0; x < latticeSize; x++)
-            cout << lattice[x][y] << " ";
-    }*/
-
-    results << t << "," << bacteriaCount << "," << lysogenicBacteriaCountA << "," << lyticBacteriaCountA << "," << lysogenicBacteriaCountB << "," << lyticBacteriaCountB << "," << (bacteriaCount-lysogenicBacteriaCountA-lyticBacteriaCountA-lysogenicBacteriaCountB-lyticBacteriaCountB) << "\n";
-    /*cout << endl << endl << "Time: " << t;
-    cout << endl << "Number of bacteria: " << bacteriaCount << " (" << (bacteriaCount - lysogenicBacteriaCount - lyticBacteriaCount) << " healthy + " << lysogenicBacteriaCount << " lysogenic + " << lyticBacteriaCount << " lytic.)";
-    cout << endl << "Number of deaths in the colony: " << deathCount;*/
-}
+        cerr << "With periodic boundaries the parallel engine needs an even number of tiles per side, the last one at least 2 sites wide ("
+             << tilesPerSide << " tiles, the last " << parameters.latticeSize - (tilesPerSide - 1)*tileSize << " wide, with --tile " << tileSize << ")." << endl;
+        return 1;
+    }
 
-void decideProgenySpot(int dice, long &row, long &col, long j, long k, int &flag) //fixes row and col from dice
-{
-                        if(dice == -1)
-                        {
-                            flag = 1;
-                        }
-                        else if(dice == 0)
-                        {
-                            row = j-1;
-                            col = k;
-                        }
-                        else if(dice == 1)
-                        {
-                            row = j;
-                            col = k+1;
-                        }
-                        else if(dice == 2)
-                        {
-                            row = j+1;
-                            col = k;
-                        }
-                        else if(dice == 3)
-                        {
-                            row = j;
-                            col = k-1;
-                        }
-}
+    ThreadPool *pool = (engine == parallelEngine) ? new ThreadPool(threadCount) : 0;
+    Simulation *simulation = new Simulation(parameters, engine, pool, tileSize);
 
-int countFreeSpots(long &j, long &k) //looks at all four neighbourhood spots and returns number of free spots and fills allowed with the status of each position
-{
-    int freeSpots = 0;
-    if(!lattice[j-1][k] && j != 0)
-    { freeSpots++; allowed[0] = 1; }
-    if(!lattice[j+1][k] && j != latticeSize-1)
-    { freeSpots++; allowed[2] = 1; }
-    if(!lattice[j][k-1] && k != 0)
-    { freeSpots++; allowed[3] = 1; }
-    if(!lattice[j][k+1] && k != latticeSize-1)
-    { freeSpots++; allowed[1] = 1; }
-    return freeSpots;
-}
-
-void beginInfectionStageA(long j, long k)
-{
-    if(infectionStatus[j+1][k+1] == 0)
-        infectionStatus[j+1][k+1] = numberOfTriesA;
-    if(infectionStatus[j+1][k-1] == 0)
-        infectionStatus[j+1][k-1] = numberOfTriesA;
-    if(infectionStatus[j-1][k+1] == 0)
-        infectionStatus[j-1][k+1] = numberOfTriesA;
-    if(infectionStatus[j-1][k-1] == 0)
-        infectionStatus[j-1][k-1] = numberOfTriesA;
-    if(infectionStatus[j][k-1] == 0)
-        infectionStatus[j][k-1] = numberOfTriesA;
-    if(infectionStatus[j][k+1] == 0)
-        infectionStatus[j][k+1] = numberOfTriesA;
-    if(infectionStatus[j-1][k] == 0)
-        infectionStatus[j-1][k] = numberOfTriesA;
-    if(infectionStatus[j+1][k] == 0)
-        infectionStatus[j+1][k] = numberOfTriesA;
-}
+    ////////////////////////////////////////////////////////////////////////////////////
+    // Initial conditions
+    ////////////////////////////////////////////////////////////////////////////////////
+    if(!checkpointFile.empty())
+        error = startingPoint.restore(*simulation);
+    else
+        simulation->generateInitialColony();
+    if(!error.empty())
+    {
+        cerr << error << endl;
+        return 1;
+    }
 
-void beginInfectionStageB(long j, long k)
-{
-    if(infectionStatus[j+1][k+1] == 0)
-        infectionStatus[j+1][k+1] = -numberOfTriesB;
-    if(infectionStatus[j+1][k-1] == 0)
-        infectionStatus[j+1][k-1] = -numberOfTriesB;
-    if(infectionStatus[j-1][k+1] == 0)
-        infectionStatus[j-1][k+1] = -numberOfTriesB;
-    if(infectionStatus[j-1][k-1] == 0)
-        infectionStatus[j-1][k-1] = -numberOfTriesB;
-    if(infectionStatus[j][k-1] == 0)
-        infectionStatus[j][k-1] = -numberOfTriesB;
-    if(infectionStatus[j][k+1] == 0)
-        infectionStatus[j][k+1] = -numberOfTriesB;
-    if(infectionStatus[j-1][k] == 0)
-        infectionStatus[j-1][k] = -numberOfTriesB;
-    if(infectionStatus[j+1][k] == 0)
-        infectionStatus[j+1][k] = -numberOfTriesB;
-}
+    //opening the results file and prepping it up
+    string resultsFile = (resultsFormat == binarySeries) ? "infectedResults.bin" : "infectedResults.csv";
+    bool continued = resuming && startingPoint.seriesBytes > 0 && results.open(resultsFile, resultsFormat, resultsEvery, resultsOnChange, parameters.phageCount, startingPoint.seriesBytes);
+    if(resuming && !continued)
+        cerr << resultsFile << " does not reach tick " << startingPoint.tick << ", starting a new one there." << endl;
+    if(!continued && !results.open(resultsFile, resultsFormat, resultsEvery, resultsOnChange, parameters.phageCount))
+    {
+        cerr << "Cannot write " << resultsFile << "." << endl;
+        return 1;
+    }
 
-void makeDecisionA(long j, long k)
-{
-    float probLysogeny = (exp(multiplicityCounter[j][k]) - 1)/(20*multiplicityCounter[j][k]);
-    if(multiplicityCounter[j][k] > 3)
-        probLysogeny = 1;
-    if(multiplicityCounter[j][k] == 1)
-        probLysogeny = 0.00;
-    if(multiplicityCounter[j][k] == 2)
-        probLysogeny = 1.00;
-    if(multiplicityCounter[j][k] == 3)
-        probLysogeny = 1.00;
-    if(multiplicityCounter[j][k] > 3)
-        probLysogeny = 1;
-    if(rand() % 100 < (probLysogeny*100))
+    string snapshotFile = resuming ? "infectedSnapshots_" + to_string(startingPoint.tick) + ".snap" : "infectedSnapshots.snap";
+    if(snapshotEvery > 0 && !snapshots.open(snapshotFile, parameters.latticeSize, snapshotEvery, snapshotKeyframes))
     {
-        lattice[j][k] = 2;
-        lysogenicBacteriaCountA++;
+        cerr << "Cannot write " << snapshotFile << "." << endl;
+        return 1;
     }
-    else
+
+    string spatialFile = resuming ? "infectedSpatial_" + to_string(startingPoint.tick) + ".csv" : "infectedSpatial.csv";
+    if(spatialEvery > 0)
     {
-        lattice[j][k] = 3;
-        lyticTimer[j][k] = 0;
-        lyticBacteriaCountA++;
+        simulation->trackSpatialStatistics(correlationRange);
+        spatialResults.open(spatialFile.c_str(), ios::out);
+        simulation->spatial.writeHeader(spatialResults);
+        if(!spatialResults)
+        {
+            cerr << "Cannot write " << spatialFile << "." << endl;
+            return 1;
+        }
     }
-}
 
-void makeDecisionB(long j, long k)
-{
-    multiplicityCounter[j][k] = abs(multiplicityCounter[j][k]);
-    float probLysogeny = (exp(multiplicityCounter[j][k]) - 1)/(20*multiplicityCounter[j][k]);//0.4 * log(multiplicityCounter[j][k] + 1);
-    if(multiplicityCounter[j][k] == 1)
-        probLysogeny = 0.00;
-    if(multiplicityCounter[j][k] == 2)
-        probLysogeny = 0.00;
-    if(multiplicityCounter[j][k] == 3)
-        probLysogeny = 1.00;
-    if(multiplicityCounter[j][k] > 3)
-        probLysogeny = 1;
-    if(rand() % 100 < (probLysogeny*100))
+    long endTick = simulation->run([simulation](long t)
+    {
+        if(checkpointEvery > 0 && t % checkpointEvery == 0 && t > simulation->startTick)
+        {
+            results.flush(); //the checkpoint records how far the series had got
+            if(!Checkpoint::write("infectedCheckpoint.ckpt", *simulation, t, results.bytes()))
+                cerr << "Could not write infectedCheckpoint.ckpt at tick " << t << "." << endl;
+        }
+        simulation->displayLattice(t, results);
+        snapshots.record(t, simulation->cells);
+        if(spatialEvery > 0 && t % spatialEvery == 0)
+        {
+            simulation->spatial.writeRow(spatialResults, t);
+            spatialLastRow = t;
+        }
+    });
+    if(!results.close())
+        cerr << "Could not write all of " << resultsFile << "." << endl;
+    if(!snapshots.close())
+        cerr << "Could not write all of " << snapshotFile << "." << endl;
+    if(spatialEvery > 0) //the lattice the run ended with
     {
-        lattice[j][k] = 4;
-        lysogenicBacteriaCountB++;
+        if(spatialLastRow != endTick)
+            simulation->spatial.writeRow(spatialResults, endTick);
+        spatialResults.close();
+        if(!spatialResults)
+            cerr << "Could not write all of " << spatialFile << "." << endl;
     }
-    else
+    if(profilingEnabled) //built with -DPHAGE_PROFILE
     {
-        lattice[j][k] = 5;
-        lyticTimer[j][k] = 0;
-        lyticBacteriaCountB++;
+        ofstream profile("infectedProfile.csv", ios::out);
+        simulation->phaseProfile().report(profile);
+        if(!profile)
+            cerr << "Could not write infectedProfile.csv." << endl;
     }
+    cout << endl << "Simulation complete at tick " << endTick << " (" << stopReasonName(simulation->stopReason) << ").";
+    delete simulation;
+    delete pool;
+    exit(0);
+    // getch();
 }
@@ -0,0 +1,339 @@
+/////////////////////////////////////////////////////////////////////////////
+// Evolutionary game over MOI-dependent lysogeny strategies, from the ODE model
+// Native replacement for paper_script_moi.py. A strategy is the lysogeny
+// propensity after one, two and three infections, (f(1), f(2), f(3)), each
+// one of 0, 0.01, ..., 1. Two phages play a game by integrating the
+// three-intermediate model of that script
+//   dB0  = g B0 (1 - Bt) - a B0 (P1 + P2)
+//   dBi1 = a B0 Pi - a Bi1 Pi - 3 d Bi1
+//   dBi2 = a Bi1 Pi - a Bi2 Pi - 3 d Bi2
+//   dBi3 = a Bi2 Pi - 3 d Bi3
+//   dLi  = g Li (1 - Bt) + 3 d (fi(1) Bi1 + fi(2) Bi2 + fi(3) Bi3)
+//   dPi  = 3 b d ((1 - fi(1)) Bi1 + (1 - fi(2)) Bi2 + (1 - fi(3)) Bi3) - a Pi Bt
+// (i = 1, 2; Bt is every bacterium) to the end time; the phage with more
+// lysogens wins. Its strategy is written to moi_winners_v_time and the
+// loser takes a mutant of it: every propensity moves to one of the grid
+// values from 3 below to 2 above (at most 0.99), as the script's slices
+// do. On a draw (equal strategies) the second phage is recorded and gets
+// the mutant.
+//
+// A game only depends on the two strategies, and the chains wander
+// around a few strategies, so the outcomes are kept in a cache shared by
+// all chains, keyed by the strategy pair; a pair is integrated once, with
+// the strategy of lower index as phage 1, and only to its final state.
+// Independent chains (--chains) run in groups that play their games in
+// lockstep, so the games missing from the cache are integrated laneCount
+// at a time (see rungeKutta.h). Chain c draws its random numbers with
+// seed + c, keyed by game, so every chain is reproducible on its own and
+// nothing depends on the number of threads or the grouping.
+//
+// Usage: moiTournament [--games N] [--chains N] [--seed S] [--threads N] [--tolerance R] [--time T] [--output file]
+//   --games N      games per chain (default 10000; the script plays N - 1 for an input of N)
+//   --chains N     independent chains (default 1)
+//   --seed S       seed of chain 0 (default 10)
+//   --threads N    worker threads (default: all hardware threads)
+//   --tolerance R  relative error allowed per integration step (default 1e-8)
+//   --time T       end time of a game (default 100)
+//   --output F     winners of every game (default moi_winners_v_time; F_chain<c> with several chains;
+//                  "none" to only print the summary)
+//
+// Build: g++ -O3 -std=c++17 -pthread -march=native -o moiTournament moiTournament.cpp
+/////////////////////////////////////////////////////////////////////////////
+#include <iostream>
+#include <algorithm>
+#include <stdio.h>
+#include <cstdlib>
+#include <cstdint>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "threadPool.h"
+#include "counterRandom.h"
+#include "rungeKutta.h"
+
+using namespace std;
+
+const int propensitySteps = 100; //propensities are 0, 1/100, ..., 1
+const uint32_t strategyCount = (propensitySteps + 1)*(propensitySteps + 1)*(propensitySteps + 1);
+
+struct MoiParameters //the parameter set and initial conditions of paper_script_moi.py
+{
+    double a; //adsorption rate
+    double g; //growth rate
+    double b; //burst size
+    double d; //lysis rate, spread over the three intermediates
+    double healthy; //B0 at t = 0
+    double phages; //P1 and P2 at t = 0
+    double endTime;
+    double tolerance;
+    double absoluteScale; //the absolute error allowed is tolerance*absoluteScale
+
+    MoiParameters() : a(20), g(1), b(100), d(1), healthy(1e-3), phages(1e-7), endTime(100), tolerance(1e-8), absoluteScale(1e-9) {}
+};
+
+inline int propensity(uint32_t strategy, int infections) //grid index of f(infections), infections = 1, 2, 3
+{
+    for(int n = 3; n > infections; n--)
+        strategy /= propensitySteps + 1;
+    return strategy % (propensitySteps + 1);
+}
+
+struct MoiSystem //the three-intermediate model for laneCount strategy pairs
+{
+    static const int equationCount = 11; //B0, B11, B12, B13, B21, B22, B23, L1, L2, P1, P2
+    const MoiParameters &p;
+    Lanes f[2][3]; //f[phage][infections - 1]
+
+    explicit MoiSystem(const MoiParameters &parameters) : p(parameters) {}
+
+    void derivative(const Lanes *x, Lanes *dx) const
+    {
+        Lanes total = x[0] + x[1] + x[2] + x[3] + x[4] + x[5] + x[6] + x[7] + x[8];
+        Lanes room = 1 - total;
+        dx[0] = p.g*x[0]*room - p.a*x[0]*(x[9] + x[10]);
+        for(int phage = 0; phage < 2; phage++)
+        {
+            const Lanes *infected = x + 1 + 3*phage, &phages = x[9 + phage];
+            Lanes *dInfected = dx + 1 + 3*phage;
+            dInfected[0] = p.a*x[0]*phages - p.a*infected[0]*phages - 3*p.d*infected[0];
+            dInfected[1] = p.a*infected[0]*phages - p.a*infected[1]*phages - 3*p.d*infected[1];
+            dInfected[2] = p.a*infected[1]*phages - 3*p.d*infected[2];
+            dx[7 + phage] = p.g*x[7 + phage]*room + 3*p.d*(f[phage][0]*infected[0] + f[phage][1]*infected[1] + f[phage][2]*infected[2]);
+            dx[9 + phage] = p.b*3*p.d*((1 - f[phage][0])*infected[0] + (1 - f[phage][1])*infected[1] + (1 - f[phage][2])*infected[2]) - p.a*phages*total;
+        }
+    }
+};
+
+class OutcomeCache //payoff of phage 1, (L1 - L2)/(L1 + L2), by strategy pair; safe to use from several threads
+{
+public:
+    bool find(uint32_t first, uint32_t second, double &payoff)
+    {
+        uint64_t key = (uint64_t)min(first, second)*strategyCount + max(first, second);
+        Shard &shard = shards[key % shardCount];
+        std::lock_guard<std::mutex> guard(shard.lock);
+        unordered_map<uint64_t, double>::const_iterator found = shard.payoffs.find(key);
+        if(found == shard.payoffs.end())
+            return false;
+        payoff = (first <= second) ? found->second : -found->second;
+        return true;
+    }
+
+    void insert(uint32_t first, uint32_t second, double payoff) //first < second
+    {
+        uint64_t key = (uint64_t)first*strategyCount + second;
+        Shard &shard = shards[key % shardCount];
+        std::lock_guard<std::mutex> guard(shard.lock);
+        shard.payoffs[key] = payoff;
+    }
+
+    long size()
+    {
+        long entries = 0;
+        for(int n = 0; n < shardCount; n++)
+        {
+            std::lock_guard<std::mutex> guard(shards[n].lock);
+            entries += shards[n].payoffs.size();
+        }
+        return entries;
+    }
+
+private:
+    static const int shardCount = 64; //so that the threads rarely wait for each other
+    struct Shard
+    {
+        std::mutex lock;
+        unordered_map<uint64_t, double> payoffs;
+    };
+    Shard shards[shardCount];
+};
+
+struct Chain
+{
+    CounterRandom random;
+    uint32_t strategy[2]; //of phage 1 and phage 2
+    FILE *winners; //0 for no output
+    double winnerSum[3]; //sum of the winning propensities over the second half of the games
+    long winnerCount;
+
+    Chain() : random(0), winners(0), winnerSum(), winnerCount(0) {}
+};
+
+uint32_t mutant(const CounterRandom &random, long game, uint32_t strategy) //the random neighbour the loser of game takes
+{
+    uint32_t numbers[4];
+    random.block(game, 0, numbers);
+    uint32_t result = 0;
+    for(int infections = 1; infections <= 3; infections++)
+    {
+        int f = propensity(strategy, infections);
+        int low = max(0, f - 3), high = min(propensitySteps, f + 3); //the script picks from F1[low:high]
+        result = result*(propensitySteps + 1) + low + CounterRandom::below(numbers[infections - 1], high - low);
+    }
+    return result;
+}
+
+//integrates the games missing from the cache, laneCount at a time; pairs are (lower, higher) strategy index and distinct
+void integrateGames(const MoiParameters &parameters, const vector<pair<uint32_t, uint32_t> > &pairs, OutcomeCache &cache)
+{
+    for(size_t first = 0; first < pairs.size(); first += laneCount)
+    {
+        MoiSystem system(parameters);
+        for(int l = 0; l < laneCount; l++)
+        {
+            const pair<uint32_t, uint32_t> &players = pairs[min(first + l, pairs.size() - 1)]; //the last batch is padded with its last pair
+            for(int infections = 1; infections <= 3; infections++)
+            {
+                system.f[0][infections - 1][l] = propensity(players.first, infections)/(double)propensitySteps;
+                system.f[1][infections - 1][l] = propensity(players.second, infections)/(double)propensitySteps;
+            }
+        }
+        Lanes x[MoiSystem::equationCount] = {};
+        x[0] += parameters.healthy;
+        x[9] += parameters.phages;
+        x[10] += parameters.phages;
+        long steps;
+        integrateLanes(system, x, parameters.endTime, parameters.tolerance, parameters.tolerance*parameters.absoluteScale, steps);
+        Lanes payoff = (x[7] - x[8])/(x[7] + x[8]);
+        for(int l = 0; l < laneCount && first + l < pairs.size(); l++)
+            cache.insert(pairs[first + l].first, pairs[first + l].second, payoff[l]);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    MoiParameters parameters;
+    long games = 10000, chainCount = 1;
+    uint64_t seed = 10;
+    int threadCount = ThreadPool::hardwareThreads();
+    string outputFile = "moi_winners_v_time";
+    for(int n = 1; n < argc; n++)
+    {
+        string option = argv[n];
+        string value = (n + 1 < argc) ? argv[n + 1] : "";
+        char *end = 0;
+        bool ok = !value.empty();
+        if(ok && option == "--games")
+            ok = (games = strtol(value.c_str(), &end, 10)) > 0 && !*end;
+        else if(ok && option == "--chains")
+            ok = (chainCount = strtol(value.c_str(), &end, 10)) > 0 && !*end;
+        else if(ok && option == "--seed")
+            ok = (seed = strtoull(value.c_str(), &end, 10), !*end);
+        else if(ok && option == "--threads")
+            ok = (threadCount = strtol(value.c_str(), &end, 10)) > 0 && !*end;
+        else if(ok && option == "--tolerance")
+            ok = (parameters.tolerance = strtod(value.c_str(), &end)) > 0 && !*end;
+        else if(ok && option == "--time")
+            ok = (parameters.endTime = strtod(value.c_str(), &end)) > 0 && !*end;
+        else if(ok && option == "--output")
+            outputFile = value;
+        else
+            ok = false;
+        if(!ok)
+        {
+            cerr << "Usage: " << argv[0] << " [--games N] [--chains N] [--seed S] [--threads N] [--tolerance R] [--time T] [--output file|none]" << endl;
+            return 1;
+        }
+        n++;
+    }
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    vector<Chain> chains(chainCount);
+    for(long c = 0; c < chainCount; c++)
+    {
+        chains[c].random = CounterRandom(seed + c);
+        uint32_t numbers[4];
+        chains[c].random.block(0, 1, numbers); //the random start of the script, the same strategy for both phages
+        chains[c].strategy[0] = 0;
+        for(int infections = 1; infections <= 3; infections++)
+            chains[c].strategy[0] = chains[c].strategy[0]*(propensitySteps + 1) + CounterRandom::below(numbers[infections - 1], propensitySteps + 1);
+        chains[c].strategy[1] = chains[c].strategy[0];
+        if(outputFile != "none")
+        {
+            string name = (chainCount == 1) ? outputFile : outputFile + "_chain" + to_string(c);
+            chains[c].winners = fopen(name.c_str(), "w");
+            if(!chains[c].winners)
+            {
+                cerr << "Cannot write " << name << "." << endl;
+                return 1;
+            }
+        }
+    }
+
+    //groups of chains play in lockstep so that their missing games fill the SIMD lanes; small enough that every thread gets some
+    ThreadPool pool(threadCount);
+    long groupSize = max(1L, min((long)(4*laneCount), (chainCount + pool.size() - 1)/pool.size()));
+    long groupCount = (chainCount + groupSize - 1)/groupSize;
+    OutcomeCache cache;
+    atomic<long> integrated(0);
+    atomic<bool> writeFailed(false);
+    pool.run(groupCount, [&](long group, int)
+    {
+        long first = group*groupSize, last = min(chainCount, first + groupSize);
+        vector<pair<uint32_t, uint32_t> > missing;
+        vector<double> payoff(last - first);
+        for(long game = 0; game < games; game++)
+        {
+            missing.clear();
+            for(long c = first; c < last; c++)
+            {
+                uint32_t one = chains[c].strategy[0], two = chains[c].strategy[1];
+                if(one != two && !cache.find(one, two, payoff[c - first]))
+                {
+                    pair<uint32_t, uint32_t> key(min(one, two), max(one, two));
+                    if(find(missing.begin(), missing.end(), key) == missing.end())
+                        missing.push_back(key);
+                }
+            }
+            integrateGames(parameters, missing, cache);
+            integrated += missing.size();
+
+            for(long c = first; c < last; c++)
+            {
+                Chain &chain = chains[c];
+                double result = 0; //equal strategies draw
+                if(chain.strategy[0] != chain.strategy[1])
+                    cache.find(chain.strategy[0], chain.strategy[1], result);
+                int winner = (result > 0) ? 0 : 1;
+                uint32_t recorded = chain.strategy[winner];
+                if(result < 0)
+                    chain.strategy[0] = mutant(chain.random, game, chain.strategy[1]);
+                else
+                    chain.strategy[1] = mutant(chain.random, game, chain.strategy[0]);
+                if(chain.winners && fprintf(chain.winners, "%g\t%g\t%g\n", propensity(recorded, 1)/(double)propensitySteps,
+                                            propensity(recorded, 2)/(double)propensitySteps, propensity(recorded, 3)/(double)propensitySteps) < 0)
+                    writeFailed = true;
+                if(2*game >= games)
+                {
+                    for(int infections = 1; infections <= 3; infections++)
+                        chain.winnerSum[infections - 1] += propensity(recorded, infections)/(double)propensitySteps;
+                    chain.winnerCount++;
+                }
+            }
+        }
+    });
+
+    double sum[3] = {0, 0, 0};
+    long count = 0;
+    for(long c = 0; c < chainCount; c++)
+    {
+        if(chains[c].winners && fclose(chains[c].winners) != 0)
+            writeFailed = true;
+        for(int n = 0; n < 3; n++)
+            sum[n] += chains[c].winnerSum[n];
+        count += chains[c].winnerCount;
+    }
+    if(writeFailed)
+    {
+        cerr << "Cannot write all of the winners files." << endl;
+        return 1;
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cout << chainCount << " chains x " << games << " games in " << seconds << " s: " << integrated << " games integrated, "
+         << cache.size() << " strategy pairs cached" << endl;
+    cout << "Mean winning strategy over the second half of the games: f(1) = " << sum[0]/count << ", f(2) = " << sum[1]/count << ", f(3) = " << sum[2]/count << endl;
+    return 0;
+}
@@ -0,0 +1,365 @@
+/////////////////////////////////////////////////////////////////////////////
+// Ensemble and parameter-sweep runner
+// Reads a grid of parameter values and a number of replicates from a
+// configuration file and runs every (grid point, replicate) pair as an
+// independent Simulation inside this process, spread over a thread pool.
+// One line of summary statistics per run is written to a CSV file, in run
+// order, as soon as all earlier runs are done.
+//
+// The configuration has one "name = value" per line; # starts a comment.
+// Any parameter of SimulationParameters may be given. A parameter with
+// several values (separated by commas or blanks) is an axis of the grid,
+// and the grid is the cartesian product of all axes, the last axis varying
+// fastest. A few names control the sweep itself:
+//   replicates = N   runs per grid point (default 1)
+//   engine = E       active, sweep or event (default active); the runs
+//                    themselves are what is parallelised
+//   threads = N      runs simulated at once (default: all hardware threads)
+//   output = file    summary file (default sweepSummary.csv)
+//   series = F       none (default), csv or binary: also write the time series
+//                    of every run, to <output without .csv>_run<n>.csv or .bin
+//   seriesEvery = N  only write every N-th tick of the series (default 1)
+//   seriesOnChange = 1  only write ticks where a count changed
+//   fork = file      start every run from the colony saved in a checkpoint
+//                    (see checkpoint.h) instead of the initial islands; the
+//                    parameters of the checkpoint are then the defaults
+//   snapshotEvery = K   also write the lattice every K ticks, to
+//                    <output without .csv>_run<n>.snap (see snapshotStream.h)
+//   spatialEvery = K    also write the statistics of the lysogen domains every
+//                    K ticks and at the end, to <output without .csv>_run<n>_spatial.csv
+//                    (see spatialStatistics.h)
+// Runs end at maxTime or when one of the stopping criteria of the parameters
+// is met (stopAtSurvivors, plateauWindow, wallClockBudget; see
+// runTermination.h), which is what makes long ensembles cheap; the last
+// column of the summary tells which: maxTime, extinction, plateau or wallClock.
+// Replicate r of every grid point uses the seed randomSeed + r, so all grid
+// points see the same random numbers (common random numbers) and runs can
+// be repeated one by one with --set randomSeed=...
+// The counts of every phage get their own columns (lysogenicBacteriaCountA,
+// lyticBacteriaCountA, lysogenicBacteriaCountB, ...), as many phages as the
+// grid point with the most of them has; the others leave theirs at 0.
+/////////////////////////////////////////////////////////////////////////////
+#ifndef PARAMETER_SWEEP_H
+#define PARAMETER_SWEEP_H
+
+#include <chrono>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "phageSimulation.h"
+#include "snapshotStream.h"
+#include "checkpoint.h"
+
+struct RunSummary //statistics of one finished run
+{
+    long ticks; //tick the run stopped at
+    long recorded; //ticks that went into sum
+    PopulationCounts final; //counters after the last tick
+    PopulationCounts sum; //counters summed over the start of every tick, for the time averages
+    long peakBacteriaCount;
+    double seconds; //wall-clock time of the run
+    StopReason stopReason; //why the run ended (see runTermination.h)
+
+    RunSummary() : ticks(0), recorded(0), final(), sum(), peakBacteriaCount(0), seconds(0), stopReason(notStopped) {}
+
+    void record(const PopulationCounts &population) //called at the start of every tick
+    {
+        recorded++;
+        sum.add(population);
+        peakBacteriaCount = std::max(peakBacteriaCount, population.bacteriaCount);
+    }
+};
+
+class ParameterSweep
+{
+public:
+    struct Axis
+    {
+        std::string name;
+        std::vector<std::string> values;
+    };
+
+    SimulationParameters base; //parameters with a single value
+    std::vector<Axis> axes; //parameters with several values
+    long replicates;
+    Engine engine;
+    int threads;
+    std::string output;
+    bool writeSeries; //time series options (see timeSeriesWriter.h)
+    SeriesFormat seriesFormat;
+    long seriesEvery;
+    bool seriesOnChange;
+    long snapshotEvery; //0 for no snapshots
+    long spatialEvery; //0 for no spatial statistics
+    bool forking; //every run starts from startingPoint instead of the initial colony
+    Checkpoint startingPoint;
+    int phageColumns; //phages with columns in the summary, the most of any grid point
+
+    ParameterSweep() : replicates(1), engine(activeEngine), threads(ThreadPool::hardwareThreads()), output("sweepSummary.csv"),
+                       writeSeries(false), seriesFormat(csvSeries), seriesEvery(1), seriesOnChange(false), snapshotEvery(0), spatialEvery(0), forking(false), phageColumns(2)
+    {}
+
+    std::string load(const std::string &fileName) //reads the configuration; returns what is wrong with it, or an empty string
+    {
+        std::ifstream in(fileName.c_str());
+        if(!in)
+            return "Cannot open " + fileName + ".";
+        std::vector<std::string> lines;
+        std::string line;
+        while(getline(in, line))
+            lines.push_back(line);
+        for(long pass = 0; pass < 2; pass++) //fork first, as the parameters of its checkpoint are the defaults for the others
+            for(size_t lineNumber = 1; lineNumber <= lines.size(); lineNumber++)
+            {
+                std::string where = fileName + ":" + std::to_string(lineNumber) + ": ";
+                line = lines[lineNumber - 1].substr(0, lines[lineNumber - 1].find('#'));
+                size_t equals = line.find('=');
+                std::string name = trim(line.substr(0, equals));
+                if(name.empty() && equals == std::string::npos)
+                    continue;
+                if(equals == std::string::npos || name.empty())
+                    return where + "expected name = value.";
+                std::vector<std::string> values = split(line.substr(equals + 1));
+                if(values.empty())
+                    return where + "no value for " + name + ".";
+                if((name == "fork") != (pass == 0))
+                    continue;
+                if(name == "fork")
+                {
+                    std::string error = values.size() == 1 ? startingPoint.open(values[0]) : name + " takes a single value.";
+                    if(!error.empty())
+                        return where + error;
+                    forking = true;
+                    base = startingPoint.params;
+                    continue;
+                }
+
+                if(name == "replicates" || name == "engine" || name == "threads" || name == "output" || name == "series" || name == "seriesEvery" || name == "seriesOnChange" || name == "snapshotEvery" || name == "spatialEvery")
+                {
+                    if(values.size() != 1)
+                        return where + name + " takes a single value.";
+                    std::istringstream value(values[0]);
+                    if(name == "replicates" && (!(value >> replicates) || replicates < 1))
+                        return where + "replicates must be a positive number.";
+                    if(name == "threads" && (!(value >> threads) || threads < 1))
+                        return where + "threads must be a positive number.";
+                    if(name == "engine" && (!parseEngine(values[0], engine) || engine == parallelEngine))
+                        return where + "engine must be active, sweep or event.";
+                    if(name == "output")
+                        output = values[0];
+                    if(name == "series" && values[0] != "none" && values[0] != "csv" && values[0] != "binary")
+                        return where + "series must be none, csv or binary.";
+                    if(name == "series")
+                    {
+                        writeSeries = values[0] != "none";
+                        seriesFormat = (values[0] == "binary") ? binarySeries : csvSeries;
+                    }
+                    if(name == "seriesEvery" && (!(value >> seriesEvery) || seriesEvery < 1))
+                        return where + "seriesEvery must be a positive number.";
+                    if(name == "seriesOnChange" && !(value >> seriesOnChange))
+                        return where + "seriesOnChange must be 0 or 1.";
+                    if(name == "snapshotEvery" && (!(value >> snapshotEvery) || snapshotEvery < 0))
+                        return where + "snapshotEvery must be a number of ticks.";
+                    if(name == "spatialEvery" && (!(value >> spatialEvery) || spatialEvery < 0))
+                        return where + "spatialEvery must be a number of ticks.";
+                    continue;
+                }
+
+                SimulationParameters scratch;
+                for(size_t n = 0; n < values.size(); n++)
+                    if(!scratch.set(name, values[n]))
+                        return where + "unknown parameter " + name + " or bad value '" + values[n] + "'.";
+                for(size_t n = 0; n < axes.size(); n++)
+                    if(axes[n].name == name)
+                        return where + name + " is given twice.";
+                base.set(name, values[0]);
+                if(values.size() > 1)
+                {
+                    Axis axis = { name, values };
+                    axes.push_back(axis);
+                }
+            }
+
+        for(long g = 0; g < gridPoints(); g++)
+        {
+            std::string error = point(g).check();
+            if(error.empty() && forking)
+                error = startingPoint.forkError(point(g));
+            if(!error.empty())
+                return "Grid point " + std::to_string(g) + ": " + error;
+        }
+        return "";
+    }
+
+    long gridPoints() const
+    {
+        long points = 1;
+        for(size_t n = 0; n < axes.size(); n++)
+            points *= axes[n].values.size();
+        return points;
+    }
+
+    SimulationParameters point(long g) const //parameters of grid point g
+    {
+        SimulationParameters p = base;
+        for(size_t n = axes.size(); n-- > 0; )
+        {
+            p.set(axes[n].name, axes[n].values[g % axes[n].values.size()]);
+            g /= axes[n].values.size();
+        }
+        return p;
+    }
+
+    bool run() //simulates every run and writes the summary file; false if a run could not start or a file cannot be written
+    {
+        std::ofstream summary(output.c_str(), std::ios::out);
+        if(!summary)
+            return false;
+        summary << "run,gridPoint,replicate";
+        for(size_t n = 0; n < axes.size(); n++)
+            summary << "," << axes[n].name;
+        phageColumns = 0;
+        for(long g = 0; g < gridPoints(); g++)
+            phageColumns = std::max(phageColumns, point(g).phageCount);
+        summary << ",seed,ticks,bacteriaCount";
+        for(int phage = 0; phage < phageColumns; phage++)
+            summary << ",lysogenicBacteriaCount" << phageLetter(phage) << ",lyticBacteriaCount" << phageLetter(phage);
+        summary << ",healthyBacteriaCount,deathCount,meanBacteriaCount";
+        for(int phage = 0; phage < phageColumns; phage++)
+            summary << ",meanLysogenicBacteriaCount" << phageLetter(phage) << ",meanLyticBacteriaCount" << phageLetter(phage);
+        summary << ",meanHealthyBacteriaCount,peakBacteriaCount,seconds,stopReason\n";
+
+        long runCount = gridPoints()*replicates;
+        std::vector<RunSummary> summaries(runCount);
+        std::vector<bool> finished(runCount, false);
+        long written = 0; //runs 0 to written-1 are in the file
+        std::mutex writeLock;
+        bool allRunsOk = true;
+
+        ThreadPool pool(threads);
+        pool.run(runCount, [&](long run, int)
+        {
+            SimulationParameters p = runParameters(run);
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            RunSummary &s = summaries[run];
+            Simulation sim(p, engine);
+            bool runOk = true;
+            if(forking)
+                runOk = startingPoint.restore(sim).empty(); //the parameters were checked by load, only mmap can fail here
+            else
+                sim.generateInitialColony();
+            TimeSeriesWriter series;
+            SnapshotWriter snapshots;
+            bool seriesOk = !writeSeries || series.open(runFile(run, seriesFormat == binarySeries ? ".bin" : ".csv"), seriesFormat, seriesEvery, seriesOnChange, p.phageCount);
+            seriesOk = (!snapshotEvery || snapshots.open(runFile(run, ".snap"), p.latticeSize, snapshotEvery)) && seriesOk;
+            std::ofstream spatial;
+            if(spatialEvery && runOk)
+            {
+                sim.trackSpatialStatistics();
+                spatial.open(runFile(run, "_spatial.csv").c_str(), std::ios::out);
+                sim.spatial.writeHeader(spatial);
+            }
+            long spatialLastRow = -1;
+            if(runOk)
+                s.ticks = sim.run([this, &s, &sim, &series, &snapshots, &spatial, &spatialLastRow](long t)
+                {
+                    s.record(sim.population);
+                    series.record(t, sim.population);
+                    snapshots.record(t, sim.cells);
+                    if(spatialEvery && t % spatialEvery == 0)
+                    {
+                        sim.spatial.writeRow(spatial, t);
+                        spatialLastRow = t;
+                    }
+                });
+            s.final = sim.population;
+            s.stopReason = sim.stopReason;
+            seriesOk = series.close() && seriesOk;
+            seriesOk = snapshots.close() && seriesOk;
+            if(spatialEvery && runOk)
+            {
+                if(spatialLastRow != s.ticks)
+                    sim.spatial.writeRow(spatial, s.ticks);
+                spatial.close();
+                seriesOk = !spatial.fail() && seriesOk;
+            }
+            s.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            std::lock_guard<std::mutex> guard(writeLock);
+            allRunsOk = allRunsOk && runOk && seriesOk;
+            finished[run] = true;
+            for(; written < runCount && finished[written]; written++)
+                writeRun(summary, written, summaries[written]);
+            summary.flush();
+        });
+        return summary && allRunsOk;
+    }
+
+private:
+    SimulationParameters runParameters(long run) const
+    {
+        SimulationParameters p = point(run/replicates);
+        p.randomSeed += run%replicates;
+        return p;
+    }
+
+    std::string runFile(long run, const std::string &extension) const //file of run with the series or snapshots
+    {
+        std::string stem = output;
+        if(stem.size() > 4 && stem.compare(stem.size() - 4, 4, ".csv") == 0)
+            stem.erase(stem.size() - 4);
+        return stem + "_run" + std::to_string(run) + extension;
+    }
+
+    void writeRun(std::ostream &summary, long run, const RunSummary &s) const
+    {
+        long g = run/replicates;
+        summary << run << "," << g << "," << run%replicates;
+        long rest = g;
+        std::vector<std::string> values(axes.size());
+        for(size_t n = axes.size(); n-- > 0; )
+        {
+            values[n] = axes[n].values[rest % axes[n].values.size()];
+            rest /= axes[n].values.size();
+        }
+        for(size_t n = 0; n < values.size(); n++)
+            summary << "," << values[n];
+        summary << "," << runParameters(run).randomSeed << "," << s.ticks << "," << s.final.bacteriaCount;
+        for(int phage = 0; phage < phageColumns; phage++)
+            summary << "," << s.final.lysogenicBacteriaCount[phage] << "," << s.final.lyticBacteriaCount[phage];
+        summary << "," << s.final.healthyBacteriaCount() << "," << s.final.deathCount;
+        double ticks = s.recorded ? s.recorded : 1;
+        summary << "," << s.sum.bacteriaCount/ticks;
+        for(int phage = 0; phage < phageColumns; phage++)
+            summary << "," << s.sum.lysogenicBacteriaCount[phage]/ticks << "," << s.sum.lyticBacteriaCount[phage]/ticks;
+        summary << "," << s.sum.healthyBacteriaCount()/ticks << "," << s.peakBacteriaCount << "," << s.seconds << "," << stopReasonName(s.stopReason) << "\n";
+    }
+
+    static std::string trim(const std::string &text)
+    {
+        size_t first = text.find_first_not_of(" \t\r");
+        if(first == std::string::npos)
+            return "";
+        return text.substr(first, text.find_last_not_of(" \t\r") - first + 1);
+    }
+
+    static std::vector<std::string> split(const std::string &text) //values separated by commas and/or blanks
+    {
+        std::vector<std::string> values;
+        std::string value;
+        std::istringstream in(text);
+        while(in >> value)
+        {
+            std::istringstream parts(value);
+            std::string part;
+            while(getline(parts, part, ','))
+                if(!part.empty())
+                    values.push_back(part);
+        }
+        return values;
+    }
+};
+
+#endif
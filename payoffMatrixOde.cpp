@@ -0,0 +1,175 @@
+/////////////////////////////////////////////////////////////////////////////
+// Payoff matrix of the fixed lysogeny propensities, from the ODE model
+// Native replacement for paper_payoff_matrix_script.py. For every pair of
+// lysogeny propensities (f1, f2) on an n x n grid it integrates the
+// one-intermediate model of that script
+//   dB0 = g B0 (1 - Bt) - a B0 (P1 + P2)
+//   dBi = a B0 Pi - d Bi
+//   dLi = g Li (1 - Bt) + fi d Bi
+//   dPi = b (1 - fi) d Bi - a Pi Bt            (i = 1, 2; Bt = B0 + B1 + B2 + L1 + L2)
+// from t = 0 to the end time and writes the payoff of phage 1,
+// (L1 - L2)/(L1 + L2) at the end time, to pydel in the layout payoff_maker.m
+// reads: f1 and f2 in percent and the payoff, tab separated, f1 varying
+// slowest. It also finds the minimax point payoff_maker.m looks for: the f1
+// whose worst payoff over all f2 is the largest.
+//
+// Only the final state is needed, so the integrator is an adaptive
+// Dormand-Prince 5(4) Runge-Kutta stepper that keeps no trajectory (see
+// rungeKutta.h). laneCount grid points are integrated together, one per
+// SIMD lane, and the batches are spread over a thread pool. The result of
+// a grid point does not depend on the number of threads. Builds with and
+// without vector instructions (-march=native) agree to the rounding of the
+// arithmetic.
+//
+// Usage: payoffMatrixOde [--grid N] [--threads N] [--tolerance R] [--time T] [--output file]
+//   --grid N       propensities 1/(N+1) ... N/(N+1) for each phage (default 99: 1% to 99%, as the script)
+//   --threads N    worker threads (default: all hardware threads)
+//   --tolerance R  relative error allowed per step (default 1e-8, about that of odeint)
+//   --time T       end time of the integration (default 50)
+//   --output F     payoff file (default pydel; "none" to only print the minimax point)
+//
+// Build: g++ -O3 -std=c++17 -pthread -march=native -o payoffMatrixOde payoffMatrixOde.cpp
+/////////////////////////////////////////////////////////////////////////////
+#include <iostream>
+#include <cmath>
+#include <stdio.h>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include "threadPool.h"
+#include "rungeKutta.h"
+
+using namespace std;
+
+struct OdeParameters //the parameter set and initial conditions of paper_payoff_matrix_script.py
+{
+    double a; //adsorption rate
+    double g; //growth rate
+    double b; //burst size
+    double d; //lysis rate of the infected intermediates
+    double healthy; //B0 at t = 0; no infected bacteria or lysogens
+    double phages; //P1 and P2 at t = 0
+    double endTime;
+    double tolerance; //relative error per step; the absolute error allowed is tolerance*absoluteScale
+    double absoluteScale;
+
+    OdeParameters() : a(20), g(1), b(100), d(1), healthy(0.001), phages(1e-7), endTime(50), tolerance(1e-8), absoluteScale(1e-9) {}
+};
+
+struct PayoffSystem //the one-intermediate model for laneCount pairs (f1, f2)
+{
+    static const int equationCount = 7; //B0, B1, B2, L1, L2, P1, P2
+    const OdeParameters &p;
+    Lanes f1, f2;
+
+    explicit PayoffSystem(const OdeParameters &parameters) : p(parameters), f1(), f2() {}
+
+    void derivative(const Lanes *x, Lanes *dx) const
+    {
+        Lanes total = x[0] + x[1] + x[2] + x[3] + x[4];
+        Lanes room = 1 - total;
+        Lanes b0 = p.a*x[0];
+        dx[0] = p.g*x[0]*room - b0*(x[5] + x[6]);
+        dx[1] = b0*x[5] - p.d*x[1];
+        dx[2] = b0*x[6] - p.d*x[2];
+        dx[3] = p.g*x[3]*room + f1*p.d*x[1];
+        dx[4] = p.g*x[4]*room + f2*p.d*x[2];
+        dx[5] = p.b*(1 - f1)*p.d*x[1] - p.a*x[5]*total;
+        dx[6] = p.b*(1 - f2)*p.d*x[2] - p.a*x[6]*total;
+    }
+};
+
+int main(int argc, char *argv[])
+{
+    OdeParameters parameters;
+    long gridSize = 99;
+    int threadCount = ThreadPool::hardwareThreads();
+    string outputFile = "pydel";
+    for(int n = 1; n < argc; n++)
+    {
+        string option = argv[n];
+        string value = (n + 1 < argc) ? argv[n + 1] : "";
+        char *end = 0;
+        bool ok = !value.empty();
+        if(ok && option == "--grid")
+            ok = (gridSize = strtol(value.c_str(), &end, 10)) > 0 && !*end;
+        else if(ok && option == "--threads")
+            ok = (threadCount = strtol(value.c_str(), &end, 10)) > 0 && !*end;
+        else if(ok && option == "--tolerance")
+            ok = (parameters.tolerance = strtod(value.c_str(), &end)) > 0 && !*end;
+        else if(ok && option == "--time")
+            ok = (parameters.endTime = strtod(value.c_str(), &end)) > 0 && !*end;
+        else if(ok && option == "--output")
+            outputFile = value;
+        else
+            ok = false;
+        if(!ok)
+        {
+            cerr << "Usage: " << argv[0] << " [--grid N] [--threads N] [--tolerance R] [--time T] [--output file|none]" << endl;
+            return 1;
+        }
+        n++;
+    }
+
+    //grid point q is (f1, f2) = ((q/n + 1)/(n + 1), (q%n + 1)/(n + 1)), the order of the script's loops
+    long pointCount = gridSize*gridSize;
+    long batchCount = (pointCount + laneCount - 1)/laneCount;
+    vector<double> payoff(pointCount);
+    vector<long> steps(batchCount);
+    ThreadPool pool(threadCount);
+    pool.run(batchCount, [&](long batch, int)
+    {
+        PayoffSystem system(parameters);
+        for(int l = 0; l < laneCount; l++)
+        {
+            long q = min(batch*laneCount + l, pointCount - 1); //the last batch is padded with its last point
+            system.f1[l] = (double)(q/gridSize + 1)/(gridSize + 1);
+            system.f2[l] = (double)(q%gridSize + 1)/(gridSize + 1);
+        }
+        Lanes x[PayoffSystem::equationCount] = {};
+        x[0] += parameters.healthy;
+        x[5] += parameters.phages;
+        x[6] += parameters.phages;
+        integrateLanes(system, x, parameters.endTime, parameters.tolerance, parameters.tolerance*parameters.absoluteScale, steps[batch]);
+        Lanes result = (x[3] - x[4])/(x[3] + x[4]); //payoff of phage 1
+        for(int l = 0; l < laneCount && batch*laneCount + l < pointCount; l++)
+            payoff[batch*laneCount + l] = result[l];
+    });
+
+    if(outputFile != "none")
+    {
+        FILE *output = fopen(outputFile.c_str(), "w");
+        bool ok = output != 0;
+        for(long q = 0; ok && q < pointCount; q++)
+            ok = fprintf(output, "%g\t%g\t%.17g\n", 100.0*(q/gridSize + 1)/(gridSize + 1), 100.0*(q%gridSize + 1)/(gridSize + 1), payoff[q]) > 0;
+        if(!output || fclose(output) != 0 || !ok)
+        {
+            cerr << "Cannot write " << outputFile << "." << endl;
+            return 1;
+        }
+    }
+
+    //minimax, as payoff_maker.m: the worst payoff of every f1 over all f2, and the f1 for which it is the largest (the first one on ties)
+    long best = 0, bestOpponent = 0;
+    double bestPayoff = -INFINITY;
+    for(long i1 = 0; i1 < gridSize; i1++)
+    {
+        long opponent = 0;
+        for(long i2 = 1; i2 < gridSize; i2++)
+            if(payoff[i1*gridSize + i2] < payoff[i1*gridSize + opponent])
+                opponent = i2;
+        if(payoff[i1*gridSize + opponent] > bestPayoff)
+        {
+            bestPayoff = payoff[i1*gridSize + opponent];
+            best = i1;
+            bestOpponent = opponent;
+        }
+    }
+    long totalSteps = 0;
+    for(long n = 0; n < batchCount; n++)
+        totalSteps += steps[n];
+    cout << "Minimax lysogeny propensity: f1 = " << 100.0*(best + 1)/(gridSize + 1) << "% (grid index " << best + 1 << "), worst payoff "
+         << bestPayoff << " against f2 = " << 100.0*(bestOpponent + 1)/(gridSize + 1) << "%" << endl;
+    cout << pointCount << " grid points, " << (double)totalSteps/batchCount << " steps per batch of " << laneCount << " (the most of its grid points)" << endl;
+    return 0;
+}
@@ -0,0 +1,195 @@
+/////////////////////////////////////////////////////////////////////////////
+// Benchmark of the spatial simulator
+// Runs fixed-seed scenarios -- every combination of engine, lattice size
+// and starting occupancy -- and prints one CSV line per scenario, so runs
+// of two versions can be compared line by line:
+//   engine, latticeSize, occupancy, ticks  the scenario
+//   seconds, ticksPerSecond                wall-clock time of the ticks (no output is written)
+//   siteUpdatesPerSecond                   bacteria updated per second (the bacteria present, summed over the ticks)
+//   meanBacteria, finalBacteria            how full the lattice was
+//   peakRssKiB                             peak resident memory of the scenario
+//   countsHash                             hash of every row the time series would have (all columns, every
+//                                          tick) and of the deaths, so a change in any count changes it
+// The occupancies are "islands", the initial colony of the paper (a
+// sparse lattice that fills up), and "full", the same islands in a lawn
+// of healthy bacteria of random ages covering every site, which stays
+// nearly full as the bacteria die one by one. Every scenario runs in a
+// child process of its own, so its peak memory is its own.
+//
+// Usage: phageBenchmark [--engines list] [--sizes list] [--occupancies list] [--time T] [--threads N] [--tile N] [--seed S]
+//   --engines      active, sweep, event and/or parallel, comma separated (default active,event,parallel)
+//   --sizes        lattice sides (default 64,256,1024)
+//   --occupancies  islands and/or full (default islands,full)
+//   --time T       ticks per scenario (default 2000)
+//   --threads N    threads of the parallel engine (default: all hardware threads)
+//   --tile N, --seed S  as for the simulator (defaults 64 and 10)
+//
+// Build: g++ -O3 -std=c++17 -pthread -march=native -o phageBenchmark phageBenchmark.cpp
+/////////////////////////////////////////////////////////////////////////////
+#include <iostream>
+#include <stdio.h>
+#include <cstdlib>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "phageSimulation.h"
+
+using namespace std;
+
+struct Scenario
+{
+    Engine engine;
+    string engineName;
+    long latticeSize;
+    string occupancy;
+};
+
+vector<string> splitList(const string &text)
+{
+    vector<string> items;
+    size_t start = 0;
+    while(start <= text.size())
+    {
+        size_t comma = text.find(',', start);
+        if(comma == string::npos)
+            comma = text.size();
+        if(comma > start)
+            items.push_back(text.substr(start, comma - start));
+        start = comma + 1;
+    }
+    return items;
+}
+
+//runs scenario in this process and returns its CSV line without the peak memory and the hash, which follow
+string runScenario(const Scenario &scenario, SimulationParameters parameters, int threadCount, long tileSize, uint64_t &hash)
+{
+    parameters.latticeSize = scenario.latticeSize;
+    ThreadPool *pool = (scenario.engine == parallelEngine) ? new ThreadPool(threadCount) : 0;
+    Simulation simulation(parameters, scenario.engine, pool, tileSize);
+    simulation.generateInitialColony();
+    if(scenario.occupancy == "full")
+        simulation.fillFreeSites(1);
+
+    double siteUpdates = 0;
+    hash = 14695981039346656037ull; //FNV-1a over the time series rows and the deaths of every tick
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    long ticks = simulation.run([&simulation, &parameters, &siteUpdates, &hash](long t)
+    {
+        const PopulationCounts &p = simulation.population;
+        siteUpdates += p.bacteriaCount;
+        long values[4 + 2*maxPhageCount];
+        uint32_t columns = TimeSeriesWriter::rowValues(t, p, parameters.phageCount, values);
+        values[columns++] = p.deathCount;
+        for(uint32_t n = 0; n < columns; n++)
+            hash = (hash ^ (uint64_t)values[n])*1099511628211ull;
+    });
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    long finalBacteria = simulation.population.bacteriaCount;
+    delete pool;
+
+    char line[512];
+    snprintf(line, sizeof(line), "%s,%ld,%s,%ld,%.4f,%.1f,%.4g,%.1f,%ld", scenario.engineName.c_str(), scenario.latticeSize, scenario.occupancy.c_str(), ticks,
+             seconds, ticks/seconds, siteUpdates/seconds, siteUpdates/(ticks ? ticks : 1), finalBacteria);
+    return line;
+}
+
+int main(int argc, char *argv[])
+{
+    vector<string> engines = splitList("active,event,parallel"), sizes = splitList("64,256,1024"), occupancies = splitList("islands,full");
+    SimulationParameters parameters;
+    parameters.maxTime = 2000;
+    int threadCount = ThreadPool::hardwareThreads();
+    long tileSize = 64;
+    for(int n = 1; n < argc; n++)
+    {
+        string option = argv[n];
+        string value = (n + 1 < argc) ? argv[n + 1] : "";
+        bool ok = !value.empty();
+        if(ok && option == "--engines")
+            engines = splitList(value);
+        else if(ok && option == "--sizes")
+            sizes = splitList(value);
+        else if(ok && option == "--occupancies")
+            occupancies = splitList(value);
+        else if(ok && option == "--time")
+            ok = parameters.set("maxTime", value);
+        else if(ok && option == "--seed")
+            ok = parameters.set("randomSeed", value);
+        else if(ok && option == "--threads")
+            ok = (threadCount = atoi(value.c_str())) > 0;
+        else if(ok && option == "--tile")
+            ok = (tileSize = atol(value.c_str())) >= 2;
+        else
+            ok = false;
+        if(!ok)
+        {
+            cerr << "Usage: " << argv[0] << " [--engines list] [--sizes list] [--occupancies list] [--time T] [--threads N] [--tile N] [--seed S]" << endl;
+            return 1;
+        }
+        n++;
+    }
+
+    vector<Scenario> scenarios;
+    for(size_t e = 0; e < engines.size(); e++)
+        for(size_t s = 0; s < sizes.size(); s++)
+            for(size_t o = 0; o < occupancies.size(); o++)
+            {
+                Scenario scenario;
+                scenario.engineName = engines[e];
+                scenario.latticeSize = atol(sizes[s].c_str());
+                scenario.occupancy = occupancies[o];
+                SimulationParameters p = parameters;
+                p.latticeSize = scenario.latticeSize;
+                string error = p.check();
+                if(!parseEngine(engines[e], scenario.engine))
+                    error = "Unknown engine " + engines[e] + ".";
+                if(occupancies[o] != "islands" && occupancies[o] != "full")
+                    error = "Unknown occupancy " + occupancies[o] + ".";
+                if(!error.empty())
+                {
+                    cerr << error << endl;
+                    return 1;
+                }
+                scenarios.push_back(scenario);
+            }
+
+    cout << "engine,latticeSize,occupancy,ticks,seconds,ticksPerSecond,siteUpdatesPerSecond,meanBacteria,finalBacteria,peakRssKiB,countsHash" << endl;
+    for(size_t n = 0; n < scenarios.size(); n++)
+    {
+        int channel[2];
+        if(pipe(channel) != 0)
+            return 1;
+        pid_t child = fork();
+        if(child == 0)
+        {
+            close(channel[0]);
+            uint64_t hash;
+            string line = runScenario(scenarios[n], parameters, threadCount, tileSize, hash);
+            char hashText[32];
+            snprintf(hashText, sizeof(hashText), ",%016llx", (unsigned long long)hash);
+            line += hashText;
+            bool written = write(channel[1], line.data(), line.size()) == (ssize_t)line.size();
+            _exit(written ? 0 : 1);
+        }
+        close(channel[1]);
+        string line;
+        char buffer[512];
+        ssize_t bytes;
+        while((bytes = read(channel[0], buffer, sizeof(buffer))) > 0)
+            line.append(buffer, bytes);
+        close(channel[0]);
+        int status = 0;
+        struct rusage usage;
+        if(child < 0 || wait4(child, &status, 0, &usage) != child || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        {
+            cerr << "Scenario " << scenarios[n].engineName << " " << scenarios[n].latticeSize << " " << scenarios[n].occupancy << " failed." << endl;
+            return 1;
+        }
+        size_t hashStart = line.rfind(',');
+        cout << line.substr(0, hashStart) << "," << usage.ru_maxrss << line.substr(hashStart) << endl; //ru_maxrss is in KiB on Linux
+    }
+    return 0;
+}
@@ -0,0 +1,1019 @@
+/////////////////////////////////////////////////////////////////////////////
+// One simulation of the spatial phage competition model
+// Everything a run needs -- parameters, lattice, active set, event schedule,
+// random numbers and population counters -- lives in a Simulation object
+// instead of in globals, so one process can hold many independent runs and
+// step them on different threads (see parameterSweep.h). The model itself
+// is described at the top of infectedBacteriaCoarse_phageCompetition.cpp.
+//
+// SimulationParameters holds the model constants. They used to be const
+// globals; they are now set at run time, by name, from the command line
+// (--set name=value) or from a sweep configuration file.
+//
+// Up to maxPhageCount phages compete, phageCount of them in a run. Every
+// phage has its own parameters and lysogeny strategy (see phageStrategy.h);
+// the states of a site are numbered so that phage p is lysogenic in state
+// 2 + 2p and lytic in 3 + 2p, which for two phages are the states of the
+// original code.
+//
+// trackSpatialStatistics turns on the domain, interface and pair correlation
+// statistics of spatialStatistics.h. Every worker then notes the sites where
+// a lysogen is born, dies or is decided, and after each tick these changes
+// are applied to the statistics on the calling thread.
+/////////////////////////////////////////////////////////////////////////////
+#ifndef PHAGE_SIMULATION_H
+#define PHAGE_SIMULATION_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <numeric>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "cellLattice.h"
+#include "siteBitmap.h"
+#include "siteKernels.h"
+#include "eventScheduler.h"
+#include "threadPool.h"
+#include "counterRandom.h"
+#include "populationCounts.h"
+#include "phaseProfiler.h"
+#include "phageStrategy.h"
+#include "runTermination.h"
+#include "spatialStatistics.h"
+#include "timeSeriesWriter.h"
+
+struct SimulationParameters
+{
+    int healthyGrowthRate; //setting growth rate to one fission every 20 cycles of the internal clock of the bacterium
+    int healthyDeathTime; //healthy bacteria die every healthyDeathTime units
+    //one entry per phage; the names end in the letter of the phage (lysogenicGrowthRateA, probInfectionB, ...)
+    int lysogenicGrowthRate[maxPhageCount]; //division time for infected bacteria
+    int lysogenicDeathTime[maxPhageCount];
+    int lysisBurstTime[maxPhageCount]; //time (after infection) after which an infected lytic bacterium bursts
+    float probInfection[maxPhageCount]; //probability of infection per burst in bacterial vicinity
+    int numberOfTries[maxPhageCount];
+    std::string strategy[maxPhageCount]; //lysogeny strategy, by name (see phageStrategy.h)
+    int phageCount; //phages competing, A, B, ...
+    int decisionTime; //time during which bacterium makes decision
+    int birthTimeRange; //+- values of time for which birth can occur
+    long latticeSize;
+    long maxTime;
+    unsigned long randomSeed;
+    bool periodicBoundary; //the lattice wraps around at its edges (a torus) instead of being closed
+    //criteria that end a run before maxTime, all off by default (see runTermination.h)
+    int stopAtSurvivors; //stop once at most this many phages are left, -1 for never
+    long plateauWindow; //stop once the counts stayed within plateauTolerance over this many ticks, 0 for never
+    double plateauTolerance;
+    double wallClockBudget; //seconds, 0 for no limit
+
+    SimulationParameters() //the values used in the paper; phages C to H start out like A, with the exponential strategy
+        : healthyGrowthRate(20), healthyDeathTime(150), phageCount(2), decisionTime(30), birthTimeRange(2),
+          latticeSize(40), maxTime(200000), randomSeed(10), periodicBoundary(false),
+          stopAtSurvivors(-1), plateauWindow(0), plateauTolerance(0.01), wallClockBudget(0)
+    {
+        for(int p = 0; p < maxPhageCount; p++)
+        {
+            lysogenicGrowthRate[p] = 30; //7
+            lysogenicDeathTime[p] = 120; //15, 22
+            lysisBurstTime[p] = 1000;
+            probInfection[p] = 0.4; //6
+            numberOfTries[p] = 3;
+            strategy[p] = (p == 0) ? "paperA" : (p == 1) ? "paperB" : "exponential";
+        }
+    }
+
+    bool set(const std::string &name, const std::string &value) //sets the parameter called name; false if there is no such parameter or value does not parse
+    {
+        std::istringstream in(value);
+        int p = name.empty() ? -1 : name.back() - 'A'; //phage of a per-phage name
+        std::string perPhage = (p >= 0 && p < maxPhageCount) ? name.substr(0, name.size() - 1) : "";
+        if(name == "healthyGrowthRate") in >> healthyGrowthRate;
+        else if(name == "healthyDeathTime") in >> healthyDeathTime;
+        else if(perPhage == "lysogenicGrowthRate") in >> lysogenicGrowthRate[p];
+        else if(perPhage == "lysogenicDeathTime") in >> lysogenicDeathTime[p];
+        else if(perPhage == "lysisBurstTime") in >> lysisBurstTime[p];
+        else if(perPhage == "probInfection") in >> probInfection[p];
+        else if(perPhage == "numberOfTries") in >> numberOfTries[p];
+        else if(perPhage == "strategy")
+        {
+            in >> strategy[p];
+            if(!KnownStrategies::known(strategy[p]))
+                return false;
+        }
+        else if(name == "phageCount") in >> phageCount;
+        else if(name == "decisionTime") in >> decisionTime;
+        else if(name == "birthTimeRange") in >> birthTimeRange;
+        else if(name == "latticeSize") in >> latticeSize;
+        else if(name == "maxTime") in >> maxTime;
+        else if(name == "randomSeed") in >> randomSeed;
+        else if(name == "periodicBoundary") in >> periodicBoundary;
+        else if(name == "stopAtSurvivors") in >> stopAtSurvivors;
+        else if(name == "plateauWindow") in >> plateauWindow;
+        else if(name == "plateauTolerance") in >> plateauTolerance;
+        else if(name == "wallClockBudget") in >> wallClockBudget;
+        else
+            return false;
+        return !in.fail() && (in >> std::ws).eof();
+    }
+
+    std::string describe() const //every parameter as a "name=value" line, readable with set
+    {
+        std::ostringstream out;
+        out.precision(9); //enough to read back every float exactly
+        out << "healthyGrowthRate=" << healthyGrowthRate << "\nhealthyDeathTime=" << healthyDeathTime << "\n";
+        for(int p = 0; p < maxPhageCount; p++)
+            out << "lysogenicGrowthRate" << phageLetter(p) << "=" << lysogenicGrowthRate[p] << "\nlysogenicDeathTime" << phageLetter(p) << "=" << lysogenicDeathTime[p]
+                << "\nlysisBurstTime" << phageLetter(p) << "=" << lysisBurstTime[p] << "\nprobInfection" << phageLetter(p) << "=" << probInfection[p]
+                << "\nnumberOfTries" << phageLetter(p) << "=" << numberOfTries[p] << "\nstrategy" << phageLetter(p) << "=" << strategy[p] << "\n";
+        out << "phageCount=" << phageCount << "\ndecisionTime=" << decisionTime << "\nbirthTimeRange=" << birthTimeRange
+            << "\nlatticeSize=" << latticeSize << "\nmaxTime=" << maxTime << "\nrandomSeed=" << randomSeed << "\nperiodicBoundary=" << periodicBoundary
+            << "\nstopAtSurvivors=" << stopAtSurvivors << "\nplateauWindow=" << plateauWindow << "\nplateauTolerance=" << plateauTolerance
+            << "\nwallClockBudget=" << wallClockBudget << "\n";
+        return out.str();
+    }
+
+    int clockFoldPeriod() const //see Simulation::clockFoldPeriod
+    {
+        int period = healthyGrowthRate;
+        for(int p = 0; p < phageCount; p++)
+            period = std::lcm(period, lysogenicGrowthRate[p]);
+        return period;
+    }
+
+    int clockFoldLimit() const
+    {
+        int lastDeath = healthyDeathTime;
+        for(int p = 0; p < phageCount; p++)
+            lastDeath = std::max(lastDeath, lysogenicDeathTime[p]);
+        return lastDeath + 1 + clockFoldPeriod();
+    }
+
+    int moiRange() const //largest multiplicity of infection a decision can see: at most one infection per tick while deciding
+    {
+        return decisionTime + 1;
+    }
+
+    std::string check() const //what is wrong with these parameters, or an empty string if they can be simulated
+    {
+        if(phageCount < 1 || phageCount > maxPhageCount)
+            return "There can be 1 to " + std::to_string(maxPhageCount) + " phages.";
+        if(latticeSize < 4 || (phageCount > 2 && latticeSize < 32))
+            return "The lattice needs at least 4 sites per side, and 32 for more than two phages.";
+        if(healthyGrowthRate <= birthTimeRange || birthTimeRange < 0 || healthyDeathTime < 1 || decisionTime < 1)
+            return "Growth rates must be longer than the birth time range, and death and decision times must be positive.";
+        int longestBurst = 0, mostTries = 0;
+        for(int p = 0; p < phageCount; p++)
+        {
+            std::string phage = std::string(" of phage ") + phageLetter(p);
+            if(lysogenicGrowthRate[p] <= birthTimeRange)
+                return "The lysogenic growth rate" + phage + " must be longer than the birth time range.";
+            if(lysogenicDeathTime[p] < 1 || lysisBurstTime[p] < 1 || numberOfTries[p] < 1)
+                return "Death and burst times and the number of tries" + phage + " must be positive.";
+            if(!KnownStrategies::known(strategy[p]))
+                return "Unknown strategy" + phage + "; the strategies are " + KnownStrategies::names() + ".";
+            longestBurst = std::max(longestBurst, lysisBurstTime[p]);
+            mostTries = std::max(mostTries, numberOfTries[p]);
+        }
+        if(stopAtSurvivors < -1 || plateauWindow < 0 || plateauTolerance < 0 || wallClockBudget < 0)
+            return "The stopping criteria cannot be negative (stopAtSurvivors -1 turns it off).";
+        if(clockFoldLimit() > INT16_MAX || longestBurst >= INT16_MAX || moiRange() > INT8_MAX || mostTries > INT8_MAX || 2*birthTimeRange > INT8_MAX || maxTime >= INT32_MAX)
+            return "Parameters do not fit the narrow per-site timers.";
+        return "";
+    }
+};
+
+enum Engine { activeEngine, sweepEngine, eventEngine, parallelEngine };
+
+inline bool parseEngine(const std::string &name, Engine &engine) //engine called name (active, sweep, event or parallel); false if there is none
+{
+    if(name == "active") engine = activeEngine;
+    else if(name == "sweep") engine = sweepEngine;
+    else if(name == "event") engine = eventEngine;
+    else if(name == "parallel") engine = parallelEngine;
+    else
+        return false;
+    return true;
+}
+
+//states of a site: 0 empty, 1 healthy, then a lysogenic and a lytic state per phage (2/3 for A, 4/5 for B, ...)
+const int stateCount = 2 + 2*maxPhageCount;
+
+inline int lysogenicState(int phage)
+{
+    return 2 + 2*phage;
+}
+
+inline int lyticState(int phage)
+{
+    return 3 + 2*phage;
+}
+
+inline int phageOfState(int state) //phage of a lysogenic or lytic state
+{
+    return (state - 2)/2;
+}
+
+inline bool isLysogenic(int state)
+{
+    return state >= 2 && state < stateCount && state % 2 == 0;
+}
+
+inline int domainOf(int state) //kind of a site for SpatialStatistics: the phage of a lysogen plus one, 0 for any other state
+{
+    return isLysogenic(state) ? phageOfState(state) + 1 : 0;
+}
+
+enum DrawSlot { infectionDraw, birthTickerDraw, progenyDraw, decisionDraw }; //which of the four numbers a site gets per tick each random choice uses
+
+struct Worker //what updateSite needs besides the lattice; every thread has its own
+{
+    PopulationCounts counts; //changes to the population since the last mergeCounts
+    const CounterRandom *random; //random numbers of the simulation the worker belongs to
+    long latticeSize;
+    long tick; //tick being updated, set by beginTick
+    long drawnSite; //site whose four numbers are in drawn, -1 if none
+    uint32_t drawn[4];
+    std::vector<uint32_t> batch; //numbers of a run of sites prefilled by CounterRandom::fill, used for the sites in [batchFirst, batchFirst + batchCount)
+    long batchFirst;
+    long batchCount;
+    uint64_t due; //sites still to visit in [dueFirst, dueEnd), bit n for site dueFirst + n (see Simulation::updateRange)
+    long dueFirst;
+    long dueEnd;
+    long visiting; //site being updated
+    int allowed[4]; //keeps track of the free spots in the neighbourhood of each bacterium, where 0 is the top, and the numbers increase clockwise (in a plus shape)
+    int randomBox[4]; //array used to keep track of indices of allowed to which cell division is allowed
+    PhaseProfile profile; //cycles and events of the work done by this worker, with -DPHAGE_PROFILE (see phaseProfiler.h)
+    bool logLysogens; //spatial statistics are kept, so lysogenChanges is filled
+    std::vector<long> lysogenChanges; //sites where a lysogen appeared or went away since the statistics were last updated
+
+    Worker() : counts(), random(0), latticeSize(0), tick(0), drawnSite(-1), batchFirst(0), batchCount(0), due(0), dueFirst(0), dueEnd(0), visiting(-1), logLysogens(false)
+    {
+        reinitAllowed();
+    }
+
+    uint32_t draw(long j, long k, DrawSlot slot) //random number for one of the choices of the bacterium at (j, k) in this tick
+    {
+        long site = j*latticeSize + k; //the key does not depend on how the planes are laid out
+        if(site - batchFirst >= 0 && site - batchFirst < batchCount)
+            return batch[slot*batchCount + site - batchFirst];
+        if(site != drawnSite)
+        {
+            random->block(tick, site, drawn);
+            drawnSite = site;
+        }
+        return drawn[slot];
+    }
+
+    void markDue(long n) //site n got something to do while its run is being visited; sites already passed wait for the next tick, as in the sweep
+    {
+        if(n > visiting && n < dueEnd)
+            due |= 1ull << (n - dueFirst);
+    }
+
+    void logLysogen(long i)
+    {
+        if(logLysogens)
+            lysogenChanges.push_back(i);
+    }
+
+    void reinitAllowed() //resets the value of allowed and randomBox every time a new bacterium is moved to
+    {
+        for(int i = 0; i < 4; i++)
+        {
+            allowed[i] = 0;
+            randomBox[i] = -1;
+        }
+    }
+
+    void beginTick(long t) //forgets the random numbers of the previous tick
+    {
+        tick = t;
+        drawnSite = -1;
+        batchCount = 0;
+    }
+};
+
+class Simulation
+{
+public:
+    const SimulationParameters params;
+    const Engine engine;
+    CellLattice cells; //stores the status, clocks and tickers of each site (see cellLattice.h)
+    SiteBitmap activeSites; //occupied sites, kept up to date by every birth and death
+    EventScheduler events; //visit schedule of the event-driven engine (see eventScheduler.h)
+    PopulationCounts population;
+    SpatialStatistics spatial; //statistics of the lysogen domains, kept after trackSpatialStatistics
+    long startTick; //first tick of run, 0 unless the simulation was resumed from a checkpoint
+    StopReason stopReason; //why run returned, notStopped before
+
+    //params must pass params.check(); the parallel engine runs its tiles on pool, which must outlive the simulation
+    Simulation(const SimulationParameters &parameters, Engine engineToUse = activeEngine, ThreadPool *tilePool = 0, long tiles = 64)
+        : params(parameters), engine(engineToUse), population(), spatial(), startTick(0), stopReason(notStopped), pool(tilePool), tileSize(tiles), siteRandom(parameters.randomSeed),
+          latticeSize(parameters.latticeSize), periodic(parameters.periodicBoundary), clockFoldPeriod(parameters.clockFoldPeriod()), clockFoldLimit(parameters.clockFoldLimit()),
+          kernels(clockFoldLimit, clockFoldPeriod, parameters.birthTimeRange)
+    {
+        for(int type = 0; type < stateCount; type++)
+        {
+            deathClock[type] = burstTimer[type] = -2; //never matches a clock or timer
+            growthRate[type] = 0;
+        }
+        deathClock[1] = params.healthyDeathTime;
+        growthRate[1] = params.healthyGrowthRate;
+        kernels.setType(1, params.healthyDeathTime, -1, params.healthyGrowthRate, healthyTicker, true);
+        int longestTimer = std::max(std::max(params.healthyDeathTime, params.decisionTime), clockFoldPeriod);
+        for(int p = 0; p < params.phageCount; p++)
+        {
+            deathClock[lysogenicState(p)] = params.lysogenicDeathTime[p];
+            growthRate[lysogenicState(p)] = params.lysogenicGrowthRate[p];
+            burstTimer[lyticState(p)] = params.lysisBurstTime[p];
+            kernels.setType(lysogenicState(p), params.lysogenicDeathTime[p], -1, params.lysogenicGrowthRate[p], infectedTicker, false);
+            kernels.setType(lyticState(p), -1, params.lysisBurstTime[p], 0, noBirthTicker, false);
+            KnownStrategies::tabulate(params.strategy[p], params.moiRange(), lysogeny[p]);
+            longestTimer = std::max(longestTimer, std::max(params.lysogenicDeathTime[p], params.lysisBurstTime[p]));
+        }
+        cells.allocate(latticeSize); //all clocks and tickers start out null (-1)
+        cells.setBoundary(periodic);
+        activeSites.resize(cells.cellCount);
+        if(engine == eventEngine) //no event is ever scheduled further ahead than the longest timer
+            events.resize(cells.cellCount, longestTimer + 1);
+        initWorker(serialWorker);
+        if(engine == parallelEngine)
+        {
+            tileWorkers.assign(pool->size(), Worker());
+            for(size_t n = 0; n < tileWorkers.size(); n++)
+                initWorker(tileWorkers[n]);
+        }
+    }
+
+    void generateInitialColony() //the initial conditions of the paper; with more than two phages the islands sit on a circle around the centre
+    {
+        // 0 represents free spot, 1 represents healthy bacterium, 2 represents infected bacterium
+        //generateIsland creates an island with an infected bacterium flanked by 4 healthy ones on an x shape centered at (x,y)
+        if(params.phageCount == 2)
+        {
+            generateIsland(latticeSize/4, latticeSize/4, lyticState(1));
+            generateIsland(3*latticeSize/4, 3*latticeSize/4, lyticState(0));
+            //generateIsland(latticeSize/4, 3*latticeSize/4, 1);
+            //generateIsland(3*latticeSize/4, latticeSize/4, 1);
+            return;
+        }
+        for(int p = 0; p < params.phageCount; p++)
+        {
+            double angle = 2*M_PI*p/params.phageCount;
+            generateIsland(latticeSize/2 + lround(latticeSize/4*cos(angle)), latticeSize/2 + lround(latticeSize/4*sin(angle)), lyticState(p));
+        }
+    }
+
+    //runs the simulation from startTick, calling observe(t) at the start of every tick (where the results are recorded), until maxTime
+    //or one of the stopping criteria of the parameters is met; returns the tick it stopped at, the reason is left in stopReason
+    template<class Observer> long run(Observer observe)
+    {
+        RunTermination termination;
+        termination.start(params.phageCount, params.stopAtSurvivors, params.plateauWindow, params.plateauTolerance, params.wallClockBudget);
+        stopReason = timeLimitReached;
+        long t;
+        for(t = startTick; t < params.maxTime; t++)
+        {
+            //srand(time(NULL));
+            {
+                PhaseTimer timer(serialWorker.profile, outputPhase);
+                observe(t); //Sleep(20000000000); //<-- I use sleep to pause the program and check some things randomly
+            }
+            StopReason reason = termination.check(t, population);
+            if(reason != notStopped)
+            {
+                stopReason = reason;
+                break;
+            }
+            step(t);
+            serialWorker.profile.count(tickEvent);
+        }
+        return t;
+    }
+
+    void synchronise(long t) //brings every site to where the sweep would have it at the start of tick t; only the event engine leaves sites behind
+    {
+        if(engine != eventEngine)
+            return;
+        for(long i = activeSites.next(0); i != -1; i = activeSites.next(i + 1))
+            if(events.lastVisit[i] < t - 1)
+            {
+                catchUpSite(i, t - 1); //clock passes up to tick t-1, decisions up to tick t-2
+                if(cells.state[i] == 1 && cells.decisionState[i] > 0) //and the visit of tick t-1, which had nothing else to do
+                    cells.decisionState[i]--;
+            }
+    }
+
+    //carries on from a lattice that was synchronised at the start of tick t and loaded into cells (see checkpoint.h), with the counters it had then
+    void resumeFrom(long t, const PopulationCounts &counts)
+    {
+        population = counts;
+        startTick = t;
+        activeSites.resize(cells.cellCount);
+        cells.setBoundary(periodic); //the halo was saved for the boundary of the checkpointed run
+        for(int p = 0; p < maxPhageCount; p++) //not saved, counted from the planes
+            population.pendingInfections[p] = population.pendingDecisions[p] = 0;
+        for(long j = 0; j < latticeSize; j++)
+            for(long i = cells.index(j, 0); i < cells.index(j, latticeSize); i++)
+            {
+                if(cells.infectionStatus[i])
+                    population.pendingInfections[cells.infectingPhage[i]]++;
+                if(cells.decisionState[i] > 0)
+                    population.pendingDecisions[cells.decidingPhage[i]]++;
+                if(cells.state[i])
+                {
+                    activeSites.insert(i);
+                    if(cells.clockTicks[i] >= clockFoldLimit) //saved with an earlier fold window, fold again (see Checkpoint::forkError)
+                        cells.clockTicks[i] = clockFoldLimit - clockFoldPeriod + (cells.clockTicks[i] - clockFoldLimit + clockFoldPeriod) % clockFoldPeriod;
+                }
+            }
+        if(engine == eventEngine) //every bacterium is visited at tick t, which then schedules its next visit
+        {
+            for(long i = activeSites.next(0); i != -1; i = activeSites.next(i + 1))
+            {
+                events.lastVisit[i] = t - 1;
+                events.schedule(i, t);
+            }
+        }
+    }
+
+    void step(long t) //one tick with the chosen engine
+    {
+        if(engine == parallelEngine) //its tasks charge the profiles of the workers that run them
+            parallelTick(t);
+        else
+        {
+            PhaseTimer timer(serialWorker.profile, enginePhase);
+            if(engine == sweepEngine)
+                sweepTick(t);
+            else if(engine == eventEngine)
+                eventTick(t);
+            else
+                activeTick(t);
+        }
+        if(spatial.tracking())
+            updateSpatialStatistics();
+    }
+
+    //keeps the spatial statistics (see spatialStatistics.h) from now on, starting from the lattice as it is, with pair correlations
+    //up to correlationRange sites; call it once the colony is in place
+    void trackSpatialStatistics(int correlationRange = defaultCorrelationRange)
+    {
+        spatial.start(latticeSize, periodic, params.phageCount, correlationRange);
+        for(long j = 0; j < latticeSize; j++)
+            for(long k = 0; k < latticeSize; k++)
+                spatial.set(j*latticeSize + k, domainOf(cells.state[cells.index(j, k)]));
+        serialWorker.logLysogens = true;
+        for(size_t n = 0; n < tileWorkers.size(); n++)
+            tileWorkers[n].logLysogens = true;
+    }
+
+    PhaseProfile phaseProfile() const //the profiles of all workers together; empty without -DPHAGE_PROFILE
+    {
+        PhaseProfile total = serialWorker.profile;
+        total.current = PhaseProfile::noPhase;
+        for(size_t n = 0; n < tileWorkers.size(); n++)
+            total.add(tileWorkers[n].profile);
+        return total;
+    }
+
+    void displayLattice(long t, TimeSeriesWriter &results) //prints the lattice to the screen and stores the data point in the results file
+    {
+        /*system("cls");
+        for(long y = 0; y < latticeSize; y++)
+        {
+            cout << endl;
+            for(long x = 0; x < latticeSize; x++)
+                cout << (int)cells.state[cells.index(x, y)] << " ";
+        }*/
+
+        results.record(t, population); //buffered, decimated and written in the background (see timeSeriesWriter.h)
+        /*cout << endl << endl << "Time: " << t;
+        cout << endl << "Number of bacteria: " << population.bacteriaCount << " (" << (population.bacteriaCount - lysogenicBacteriaCount - lyticBacteriaCount) << " healthy + " << lysogenicBacteriaCount << " lysogenic + " << lyticBacteriaCount << " lytic.)";
+        cout << endl << "Number of deaths in the colony: " << population.deathCount;*/
+    }
+
+    void generateBacterium(int type, long relativePosX, long relativePosY)
+    {
+        long i = cells.index(latticeSize/2 + relativePosX, latticeSize/2 + relativePosY);
+        cells.state[i] = type;
+        cells.clockTicks[i] = 0;
+        if(periodic)
+            cells.mirror(i);
+        activeSites.insert(i);
+        if(engine == eventEngine)
+            events.wake(i); //first visit at tick 0
+        population.bacteriaCount++;
+        if(isLysogenic(type))
+            population.lysogenicBacteriaCount[phageOfState(type)]++;
+        else if(type != 1)
+        {
+            population.lyticBacteriaCount[phageOfState(type)]++;
+            cells.lyticTimer[i] = 0;
+        }
+    }
+
+    //puts a bacterium of type on every empty site, to start from a confluent lawn. Each gets a random age below the death
+    //time of its type, so the lawn does not die all at once; the ages come from tick -1, which is never simulated.
+    void fillFreeSites(int type)
+    {
+        uint32_t drawn[4];
+        for(long j = 0; j < latticeSize; j++)
+            for(long k = 0; k < latticeSize; k++)
+            {
+                long i = cells.index(j, k);
+                if(cells.state[i])
+                    continue;
+                generateBacterium(type, j - latticeSize/2, k - latticeSize/2);
+                siteRandom.block(-1, j*latticeSize + k, drawn);
+                cells.clockTicks[i] = CounterRandom::below(drawn[0], deathClock[type]);
+            }
+    }
+
+    void generateIsland(long centerX, long centerY, int centerType)
+    {
+        generateBacterium(centerType, centerX - latticeSize/2, centerY - latticeSize/2);
+        generateBacterium(1, centerX - latticeSize/2 - 1, centerY - latticeSize/2 - 1);
+        generateBacterium(1, centerX - latticeSize/2 - 1, centerY - latticeSize/2 + 1);
+        generateBacterium(1, centerX - latticeSize/2 + 1, centerY - latticeSize/2 - 1);
+        generateBacterium(1, centerX - latticeSize/2 + 1, centerY - latticeSize/2 + 1);
+    }
+
+private:
+    ThreadPool *pool;
+    long tileSize;
+    CounterRandom siteRandom; //keyed with params.randomSeed
+    Worker serialWorker; //used by the active, sweep and event engines
+    std::vector<Worker> tileWorkers; //one per thread of the parallel engine
+    const long latticeSize;
+    const bool periodic; //halo sites mirror the opposite edges instead of being blocked (see cellLattice.h)
+
+    //clockTicks is only 16 bits wide, but lysogens that are infected late in life never reach their death time and live forever.
+    //Past the last death time the clock only matters modulo the growth rates, so it is folded back by a common multiple of them
+    //once it reaches clockFoldLimit. This keeps every comparison in the sweep exactly as it was with unbounded clocks.
+    const int clockFoldPeriod;
+    const int clockFoldLimit;
+    SiteKernels kernels; //clock pass and due masks (see siteKernels.h)
+    int deathClock[stateCount]; //clock at which a bacterium of each state dies, -2 for never
+    int burstTimer[stateCount]; //lyticTimer at which it bursts, -2 for never
+    int growthRate[stateCount]; //division time of the states that divide, 0 for the others
+    LysogenyTable lysogeny[maxPhageCount]; //strategy of every phage, by multiplicity of infection (see phageStrategy.h)
+
+    void initWorker(Worker &w)
+    {
+        w.random = &siteRandom;
+        w.latticeSize = latticeSize;
+    }
+
+    void mergeCounts(Worker &w) //adds the population changes made by w to the counters of the simulation
+    {
+        population.add(w.counts);
+        w.counts = PopulationCounts();
+    }
+
+    void updateSpatialStatistics() //applies the lysogen changes the workers noted in the last tick; their order does not matter
+    {
+        PhaseTimer timer(serialWorker.profile, spatialPhase);
+        for(size_t n = 0; n <= tileWorkers.size(); n++)
+        {
+            Worker &w = (n < tileWorkers.size()) ? tileWorkers[n] : serialWorker;
+            for(size_t c = 0; c < w.lysogenChanges.size(); c++)
+            {
+                long i = w.lysogenChanges[c];
+                spatial.set(cells.row(i)*latticeSize + cells.column(i), domainOf(cells.state[i]));
+            }
+            w.lysogenChanges.clear();
+        }
+    }
+
+    void sweepTick(long t) //the original full sweep, visiting every site twice
+    {
+        serialWorker.beginTick(t);
+        //increment internal clocks for each bacterium, decrementing the birth tickers for each time step; the halo sites in between rows have no clocks
+        {
+            PhaseTimer timer(serialWorker.profile, clockPhase);
+            kernels.advance(cells, cells.index(0, 0), cells.index(latticeSize - 1, latticeSize) - cells.index(0, 0));
+        }
+
+        //sweeping through the lattice
+        for(long j = 0; j < latticeSize; j++)
+            for(long k = 0; k < latticeSize; k++)
+                if(cells.state[cells.index(j, k)]) //looking for a non-empty site
+                    updateSite(j, k, serialWorker);
+        mergeCounts(serialWorker);
+    }
+
+    void activeTick(long t)
+    {
+        serialWorker.beginTick(t);
+        //empty sites have null clocks and tickers, so only the occupied ones need to be visited;
+        //daughters placed ahead of the current site join activeSites and are still visited in this tick, as in the full sweep
+        advanceRange(0, cells.cellCount, serialWorker);
+        updateRange(0, cells.cellCount, serialWorker);
+        mergeCounts(serialWorker);
+    }
+
+    void eventTick(long t)
+    {
+        serialWorker.beginTick(t);
+        //only the bacteria with something due this tick are visited, still in row-major order; their clocks are first
+        //brought forward over the ticks in which they were left alone
+        if(events.beginTick(t))
+            for(long i = events.nextSite(); i != -1; i = events.nextSite())
+                if(cells.state[i])
+                {
+                    catchUpSite(i, t);
+                    updateSite(cells.row(i), cells.column(i), serialWorker);
+                    PhaseTimer timer(serialWorker.profile, schedulePhase);
+                    scheduleNextVisit(i, t);
+                }
+        mergeCounts(serialWorker);
+    }
+
+    //The parallel engine cuts the lattice into tileSize x tileSize tiles and colours them like a 2x2 checkerboard of tiles.
+    //A site only reads and writes its 8 neighbours, so tiles of the same colour, which have a whole tile between them,
+    //never touch the same site as long as every tile is at least 2 sites wide, and are updated concurrently. The four colours are done one after the other, and
+    //inside a tile the sites are visited in row-major order. Random numbers only depend on the tick and the site, so the
+    //result does not depend on which thread runs which tile or on the number of threads. Rows of a tile that are densely
+    //populated get their random numbers in one batch. With closed boundaries a narrower last tile is harmless, as it only
+    //ever lies beyond the others. With periodic boundaries the tiles on opposite edges are neighbours too, so the number
+    //of tiles per side must then be even (or 1) and the last tile, which lies between the first and the last but one,
+    //at least 2 sites wide.
+    void parallelTick(long t)
+    {
+        long tilesPerSide = (latticeSize + tileSize - 1)/tileSize;
+
+        pool->run(tilesPerSide, [this](long band, int worker) //clock pass, one band of tile rows per task
+        {
+            long first = cells.index(band*tileSize, 0);
+            long last = cells.index(std::min((band + 1)*tileSize, latticeSize), 0);
+            advanceRange(first, last, tileWorkers[worker]);
+        });
+
+        for(int colour = 0; colour < 4; colour++)
+        {
+            long colourRows = (tilesPerSide + 1 - colour/2)/2; //tile rows and columns of this colour
+            long colourCols = (tilesPerSide + 1 - colour%2)/2;
+            pool->run(colourRows*colourCols, [this, t, colour, colourCols](long task, int worker)
+            {
+                long tileRow = 2*(task/colourCols) + colour/2;
+                long tileCol = 2*(task%colourCols) + colour%2;
+                Worker &w = tileWorkers[worker];
+                PhaseTimer timer(w.profile, enginePhase);
+                w.beginTick(t);
+                for(long j = tileRow*tileSize; j < std::min((tileRow + 1)*tileSize, latticeSize); j++)
+                {
+                    long first = cells.index(j, tileCol*tileSize);
+                    long last = cells.index(j, std::min((tileCol + 1)*tileSize, latticeSize));
+                    if(4*activeSites.count(first, last) >= last - first) //at least a quarter occupied
+                    {
+                        PhaseTimer timer(w.profile, scanPhase);
+                        w.batchFirst = j*latticeSize + tileCol*tileSize;
+                        w.batchCount = last - first;
+                        w.batch.resize(4*w.batchCount);
+                        siteRandom.fill(t, w.batchFirst, w.batchCount, &w.batch[0]);
+                    }
+                    else
+                        w.batchCount = 0;
+                    updateRange(first, last, w);
+                }
+            });
+        }
+        for(size_t n = 0; n < tileWorkers.size(); n++)
+            mergeCounts(tileWorkers[n]);
+    }
+
+    void advanceRange(long first, long last, Worker &w) //clock pass over the 64-site words of [first, last) that hold a bacterium
+    {
+        PhaseTimer timer(w.profile, clockPhase);
+        for(long i = activeSites.next(first, last); i != -1; i = activeSites.next((i | 63) + 1, last))
+            kernels.advance(cells, i, std::min((i | 63) + 1, last) - i);
+    }
+
+    //updates the bacteria in [first, last) in increasing site order, skipping those the due mask of their word leaves out;
+    //sites ahead in the word that get something to do during the visits (daughters, infections) are added with Worker::markDue
+    void updateRange(long first, long last, Worker &w)
+    {
+        for(long i = activeSites.next(first, last); i != -1; i = activeSites.next(w.dueEnd, last))
+        {
+            w.dueFirst = i;
+            w.dueEnd = std::min((i | 63) + 1, last);
+            {
+                PhaseTimer timer(w.profile, scanPhase);
+                w.due = kernels.due(cells, i, w.dueEnd - i) & (activeSites.word(i) >> (i & 63));
+            }
+            while(w.due)
+            {
+                w.visiting = w.dueFirst + __builtin_ctzll(w.due);
+                w.due &= w.due - 1;
+                updateSite(cells.row(w.visiting), cells.column(w.visiting), w);
+            }
+        }
+        w.dueEnd = 0;
+        w.visiting = -1;
+    }
+
+    void catchUpSite(long i, long t) //applies what the sweep would have done to bacterium i on the ticks since its last visit, up to the clock pass of tick t
+    {
+        PhaseTimer timer(serialWorker.profile, clockPhase);
+        long dt = t - events.lastVisit[i];
+        if(dt <= 0) //born earlier in this tick, nothing to catch up
+            return;
+        events.lastVisit[i] = t;
+
+        long clock = cells.clockTicks[i] + dt; //dt clock passes, folded as SiteKernels::advance would have done step by step
+        if(clock >= clockFoldLimit)
+            clock = clockFoldLimit - clockFoldPeriod + (clock - clockFoldLimit + clockFoldPeriod) % clockFoldPeriod;
+        cells.clockTicks[i] = clock;
+        if(cells.healthyBirthTicker[i] >= 0)
+            cells.healthyBirthTicker[i] = std::max(cells.healthyBirthTicker[i] - dt, -1L);
+        if(cells.infectedBirthTicker[i] >= 0)
+            cells.infectedBirthTicker[i] = std::max(cells.infectedBirthTicker[i] - dt, -1L);
+        if(cells.lyticTimer[i] != -1)
+            cells.lyticTimer[i] += dt;
+
+        //the only thing the skipped visits changed is the decision countdown of healthy bacteria (dt - 1 of them, tick t is still to come);
+        //scheduleNextVisit makes sure it cannot have reached 0 in between
+        if(cells.state[i] == 1 && cells.decisionState[i] > 0)
+            cells.decisionState[i] -= dt - 1;
+    }
+
+    void scheduleNextVisit(long i, long t) //schedules bacterium i for the first tick after t at which updateSite could act on it
+    {
+        int type = cells.state[i];
+        if(!type) //died in this visit
+            return;
+        if(type == 1 && cells.infectionStatus[i]) //an infection is tried every tick
+        {
+            events.schedule(i, t + 1);
+            return;
+        }
+
+        long clock = cells.clockTicks[i];
+        long next = t + clockFoldPeriod + 1; //further than any of the candidates below
+        if(deathClock[type] >= 0 && clock < deathClock[type])
+            next = std::min(next, t + deathClock[type] - clock);
+        if(burstTimer[type] >= 0)
+            next = std::min(next, t + burstTimer[type] - cells.lyticTimer[i]);
+        if(type == 1 && cells.decisionState[i])
+            next = std::min(next, t + cells.decisionState[i]);
+
+        int birthTicker = (type == 1) ? cells.healthyBirthTicker[i] : cells.infectedBirthTicker[i];
+        int growth = growthRate[type];
+        if(growth && birthTicker > 0) //division
+            next = std::min(next, t + birthTicker);
+        if(growth) //next opening of the birth window, where the birth ticker is drawn
+        {
+            long wait = ((growth - params.birthTimeRange) - clock % growth + growth) % growth;
+            next = std::min(next, t + (wait ? wait : growth));
+        }
+        if(burstTimer[type] >= 0 || growth)
+            events.schedule(i, next);
+    }
+
+    void updateSite(long j, long k, Worker &w) //one step of the bacterium at row j, column k: death or burst, infection, decision and division
+    {
+        long i = cells.index(j, k);
+        w.profile.count(visitEvent);
+        //making sure the ticker for the bacterium hasn't gone below -1
+        if(cells.healthyBirthTicker[i] < -1)
+            cells.healthyBirthTicker[i] = -1;
+        if(cells.infectedBirthTicker[i] < -1)
+            cells.infectedBirthTicker[i] = -1;
+
+        //this loop kills things if their time has come: healthy and lysogenic cells at their death time, lytic ones at their burst time
+        int type = cells.state[i];
+        if(cells.clockTicks[i] == deathClock[type] || cells.lyticTimer[i] == burstTimer[type])
+        {
+            PhaseTimer timer(w.profile, deathPhase);
+            w.profile.count(type != 1 && !isLysogenic(type) ? burstEvent : deathEvent);
+            if(isLysogenic(type))
+            {
+                w.counts.lysogenicBacteriaCount[phageOfState(type)]--;
+                w.logLysogen(i);
+            }
+            else if(type != 1)
+            {
+                w.counts.lyticBacteriaCount[phageOfState(type)]--;
+                beginInfectionStage(i, phageOfState(type), w);
+            }
+            if(cells.infectionStatus[i]) //infections and decisions in progress end with the bacterium
+                w.counts.pendingInfections[cells.infectingPhage[i]]--;
+            if(cells.decisionState[i] > 0)
+                w.counts.pendingDecisions[cells.decidingPhage[i]]--;
+            cells.state[i] = 0; //resetting all counters and stuff here
+            if(periodic)
+                cells.mirror(i);
+            cells.clockTicks[i] = -1;
+            cells.lyticTimer[i] = -1; //only ever read for lytic cells, reset so the 16-bit timer cannot wrap on an empty site
+            cells.healthyBirthTicker[i] = -1;
+            cells.infectedBirthTicker[i] = -1;
+            cells.multiplicityCounter[i] = 0;
+            cells.infectionStatus[i] = 0;
+            cells.decisionState[i] = 0;
+            activeSites.erase(i);
+            w.counts.bacteriaCount--;
+            w.counts.deathCount++;
+            return; //return skips the rest of the update for this bacterium
+        }
+
+        if(cells.state[i] == 1)
+        {
+            if(cells.infectionStatus[i] > 0) //infectingPhage tells which phage is trying
+            {
+                PhaseTimer timer(w.profile, infectionPhase);
+                w.profile.count(infectionTryEvent);
+                int phage = cells.infectingPhage[i];
+                if(CounterRandom::bernoulli(w.draw(j, k, infectionDraw), params.probInfection[phage]))
+                {
+                    w.profile.count(infectionEvent);
+                    if(!cells.decisionState[i]) //the first phage to get in decides, the others count against it
+                    {
+                        cells.decisionState[i] = params.decisionTime;
+                        cells.decidingPhage[i] = phage;
+                        w.counts.pendingDecisions[phage]++;
+                    }
+                    cells.multiplicityCounter[i] += (cells.decidingPhage[i] == phage) ? 1 : -1;
+                }
+                cells.infectionStatus[i]--;
+                if(!cells.infectionStatus[i])
+                    w.counts.pendingInfections[phage]--;
+            }
+
+            if(cells.decisionState[i] > 0)
+            {
+                cells.decisionState[i]--;
+                if(!cells.decisionState[i])
+                    makeDecision(j, k, w);
+            }
+        }
+
+        //choosing random times for cell division if the current clock of the cell reads a time just within the division age (so at 25 if the division age is 30 and the range is 5)
+        //srand(time(NULL)); //seeding the random number generator with the system time
+        if((cells.healthyBirthTicker[i] == -1) && (cells.clockTicks[i] != 0) && (cells.clockTicks[i] % params.healthyGrowthRate == (params.healthyGrowthRate - params.birthTimeRange)) && cells.state[i] == 1)
+            cells.healthyBirthTicker[i] = CounterRandom::below(w.draw(j, k, birthTickerDraw), params.birthTimeRange*2 + 1); //below(x, n) turns a random number into an integer between 0 and n-1
+
+        //srand(time(NULL));
+        type = cells.state[i]; //the decision may have changed it
+        if((cells.infectedBirthTicker[i] == -1) && (cells.clockTicks[i] != 0) && isLysogenic(type) && (cells.clockTicks[i] % growthRate[type] == (growthRate[type] - params.birthTimeRange)))
+            cells.infectedBirthTicker[i] = CounterRandom::below(w.draw(j, k, birthTickerDraw), params.birthTimeRange*2 + 1);
+
+        //loop checks if the growth age for the cell has been reached and initiates cell division; clockTicks != 0 makes sure newly-born bacteria can't pass this check
+        if(((cells.healthyBirthTicker[i] == 0 && cells.state[i] == 1) || (cells.infectedBirthTicker[i] == 0 && isLysogenic(type)) && cells.clockTicks[i] != 0 && !cells.infectionStatus[i] && !cells.decisionState[i]))
+        {
+            PhaseTimer timer(w.profile, divisionPhase);
+            long row = 0, col = 0; //keeps track of where the daughter should be placed
+            int flag = 0; //used in case of no free spots
+            int dice; //dice and tempDice are random variables that choose the division spot
+            int tempDice;
+            do
+            {
+                //srand(time(NULL)); //seeding the random number generator with the system time
+                if(countFreeSpots(i, w) == 0) //if no free spots
+                {   tempDice = -1; break;    } //break comes out of the loop
+                int boxCount = 0; //keeps the index of the traversal through randomBox
+                for(int index = 0; index < 4; index++)
+                    if(w.allowed[index]) //w.allowed[index] is 1 if the index position is free (0 is top, 1 is right, 2 is bottom, 3 is left)
+                        w.randomBox[boxCount++] = index;
+                tempDice = w.randomBox[CounterRandom::below(w.draw(j, k, progenyDraw), boxCount)]; //picking out a random position from the free location indices stored in randomBox
+                break;
+            }while(tempDice != -1);
+            w.reinitAllowed();
+            dice = tempDice;
+
+            decideProgenySpot(dice, row, col, j, k, flag); //fixes values of row and col based on the position chosen by dice
+
+            long daughter = cells.index(row, col); //a halo site only if the boundary is periodic, blocked ones are never free
+            if(periodic)
+                daughter = cells.wrap(daughter);
+            if(!flag && !cells.state[daughter]) //places progeny if free spots are available (!a is equivalent to a == 0)
+            {
+                w.profile.count(birthEvent);
+                cells.state[daughter] = cells.state[i];
+                if(periodic)
+                    cells.mirror(daughter);
+                cells.clockTicks[daughter] = 0; //setting clock of the newborn to 0
+                w.counts.bacteriaCount++;
+                cells.healthyBirthTicker[daughter] = -1;
+                cells.infectedBirthTicker[daughter] = -1;
+                activeSites.insert(daughter);
+                if(engine == eventEngine)
+                {
+                    events.lastVisit[daughter] = events.tick(); //the clock pass of this tick is already behind the newborn
+                    events.wake(daughter);
+                }
+                else
+                    w.markDue(daughter); //may be infected on its first visit
+                if(isLysogenic(type))
+                {
+                    w.counts.lysogenicBacteriaCount[phageOfState(type)]++;
+                    w.logLysogen(daughter);
+                }
+                //displayLattice(t);
+            }
+        }
+    }
+
+    static void decideProgenySpot(int dice, long &row, long &col, long j, long k, int &flag) //fixes row and col from dice
+    {
+                            if(dice == -1)
+                            {
+                                flag = 1;
+                            }
+                            else if(dice == 0)
+                            {
+                                row = j-1;
+                                col = k;
+                            }
+                            else if(dice == 1)
+                            {
+                                row = j;
+                                col = k+1;
+                            }
+                            else if(dice == 2)
+                            {
+                                row = j+1;
+                                col = k;
+                            }
+                            else if(dice == 3)
+                            {
+                                row = j;
+                                col = k-1;
+                            }
+    }
+
+    int countFreeSpots(long i, Worker &w) //looks at all four neighbourhood spots of site i and returns number of free spots and fills allowed with the status of each position
+    {
+        //the halo makes every neighbour a valid site, and a blocked one is never free, so there is nothing to check at the edges
+        w.allowed[0] = !cells.state[i - cells.stride];
+        w.allowed[1] = !cells.state[i + 1];
+        w.allowed[2] = !cells.state[i + cells.stride];
+        w.allowed[3] = !cells.state[i - 1];
+        return w.allowed[0] + w.allowed[1] + w.allowed[2] + w.allowed[3];
+    }
+
+    void seedInfection(long n, int phage, Worker &w) //marks site n for infection by phage unless it is already being infected
+    {
+        if(cells.state[n] == blockedSite) //neighbours off the edge of a closed lattice
+            return;
+        if(periodic)
+            n = cells.wrap(n);
+        if(cells.infectionStatus[n] == 0)
+        {
+            cells.infectionStatus[n] = params.numberOfTries[phage];
+            cells.infectingPhage[n] = phage;
+            w.counts.pendingInfections[phage]++;
+            if(engine == eventEngine && cells.state[n])
+                events.wake(n);
+            else if(cells.state[n])
+                w.markDue(n);
+        }
+    }
+
+    void beginInfectionStage(long i, int phage, Worker &w) //seeds the 8 neighbours of the site i where phage burst out
+    {
+        long s = cells.stride;
+        seedInfection(i + s + 1, phage, w);
+        seedInfection(i + s - 1, phage, w);
+        seedInfection(i - s + 1, phage, w);
+        seedInfection(i - s - 1, phage, w);
+        seedInfection(i - 1, phage, w);
+        seedInfection(i + 1, phage, w);
+        seedInfection(i - s, phage, w);
+        seedInfection(i + s, phage, w);
+    }
+
+    void makeDecision(long j, long k, Worker &w) //lysis or lysogeny for the deciding phage, from its strategy and the multiplicity of infection
+    {
+        PhaseTimer timer(w.profile, decisionPhase);
+        w.profile.count(decisionEvent);
+        long i = cells.index(j, k);
+        int phage = cells.decidingPhage[i];
+        w.counts.pendingDecisions[phage]--;
+        if(CounterRandom::bernoulli(w.draw(j, k, decisionDraw), lysogeny[phage][cells.multiplicityCounter[i]]))
+        {
+            w.profile.count(lysogenyEvent);
+            cells.state[i] = lysogenicState(phage);
+            if(periodic)
+                cells.mirror(i);
+            w.counts.lysogenicBacteriaCount[phage]++;
+            w.logLysogen(i);
+        }
+        else
+        {
+            cells.state[i] = lyticState(phage);
+            if(periodic)
+                cells.mirror(i);
+            cells.lyticTimer[i] = 0;
+            w.counts.lyticBacteriaCount[phage]++;
+        }
+    }
+
+    Simulation(const Simulation &); //owns its lattice, copying is not allowed
+    Simulation &operator=(const Simulation &);
+};
+
+#endif
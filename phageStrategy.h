@@ -0,0 +1,154 @@
+/////////////////////////////////////////////////////////////////////////////
+// Lysogeny strategies of the phages
+// A strategy maps the multiplicity of infection (MOI) of a bacterium at the
+// end of its decision time to the probability that the deciding phage goes
+// lysogenic. Every strategy is a small policy class with a static
+// lysogeny(moi) and a name; the simulation tabulates the strategy of each
+// phage once, for every MOI that can occur, into a LysogenyTable, so the
+// decision itself is one table lookup: no exp() and no dispatch.
+//
+// The MOI counts the successful infections by the deciding phage (the one
+// that infected first) minus those by the other phages while the decision
+// was pending, so it can be 0 or negative when phages compete for a cell.
+// paperA and paperB are the two strategies of the paper, including how
+// they treat such cells: paperA evaluates (e^m - 1)/20m as it stands (0/0
+// for m = 0 gives no lysogeny), paperB only looks at |m|.
+//
+// New strategies are added by writing the policy and listing it in
+// KnownStrategies.
+/////////////////////////////////////////////////////////////////////////////
+#ifndef PHAGE_STRATEGY_H
+#define PHAGE_STRATEGY_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+struct PaperStrategyA
+{
+    static std::string name() { return "paperA"; }
+
+    static float lysogeny(int moi)
+    {
+        float probLysogeny = (exp(moi) - 1)/(20*moi);
+        if(moi > 3)
+            probLysogeny = 1;
+        if(moi == 1)
+            probLysogeny = 0.00;
+        if(moi == 2)
+            probLysogeny = 1.00;
+        if(moi == 3)
+            probLysogeny = 1.00;
+        return probLysogeny;
+    }
+};
+
+struct PaperStrategyB
+{
+    static std::string name() { return "paperB"; }
+
+    static float lysogeny(int moi)
+    {
+        moi = abs(moi);
+        float probLysogeny = (exp(moi) - 1)/(20*moi);//0.4 * log(multiplicityCounter[j][k] + 1);
+        if(moi == 1)
+            probLysogeny = 0.00;
+        if(moi == 2)
+            probLysogeny = 0.00;
+        if(moi == 3)
+            probLysogeny = 1.00;
+        if(moi > 3)
+            probLysogeny = 1;
+        return probLysogeny;
+    }
+};
+
+struct ExponentialStrategy //the curve both paper strategies start from, without their overrides
+{
+    static std::string name() { return "exponential"; }
+
+    static float lysogeny(int moi)
+    {
+        return moi < 1 ? 0 : std::min(1.0, (exp(moi) - 1)/(20*moi));
+    }
+};
+
+template<int K> struct ThresholdStrategy //lysogeny once at least K phages got in
+{
+    static std::string name() { return "threshold" + std::to_string(K); }
+
+    static float lysogeny(int moi)
+    {
+        return moi >= K ? 1 : 0;
+    }
+};
+
+template<int Percent> struct FixedStrategy //a fixed lysogeny propensity, as in the ODE payoff matrix
+{
+    static std::string name() { return "fixed" + std::to_string(Percent); }
+
+    static float lysogeny(int)
+    {
+        return Percent/100.0f;
+    }
+};
+
+class LysogenyTable //a strategy evaluated for every MOI in [-range, range]; MOIs outside are clamped
+{
+public:
+    LysogenyTable() : range(0), values(1, 0.0f) {}
+
+    template<class Strategy> void tabulate(int moiRange)
+    {
+        range = moiRange;
+        values.resize(2*range + 1);
+        for(int moi = -range; moi <= range; moi++)
+            values[moi + range] = Strategy::lysogeny(moi);
+    }
+
+    float operator[](int moi) const
+    {
+        return values[std::min(std::max(moi, -range), range) + range];
+    }
+
+private:
+    int range;
+    std::vector<float> values;
+};
+
+template<class... Strategies> struct StrategyList
+{
+    static bool known(const std::string &name)
+    {
+        return ((Strategies::name() == name) || ...);
+    }
+
+    static bool tabulate(const std::string &name, int moiRange, LysogenyTable &table) //fills table with the strategy called name; false if there is none
+    {
+        return (tabulateIf<Strategies>(name, moiRange, table) || ...);
+    }
+
+    static std::string names() //for error messages
+    {
+        std::string list;
+        ((list += (list.empty() ? "" : ", ") + Strategies::name()), ...);
+        return list;
+    }
+
+private:
+    template<class Strategy> static bool tabulateIf(const std::string &name, int moiRange, LysogenyTable &table)
+    {
+        if(Strategy::name() != name)
+            return false;
+        table.tabulate<Strategy>(moiRange);
+        return true;
+    }
+};
+
+typedef StrategyList<PaperStrategyA, PaperStrategyB, ExponentialStrategy,
+                     ThresholdStrategy<1>, ThresholdStrategy<2>, ThresholdStrategy<3>, ThresholdStrategy<4>,
+                     FixedStrategy<0>, FixedStrategy<25>, FixedStrategy<50>, FixedStrategy<75>, FixedStrategy<100>> KnownStrategies;
+
+#endif
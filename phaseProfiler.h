@@ -0,0 +1,148 @@
+/////////////////////////////////////////////////////////////////////////////
+// Per-phase profile of the simulation
+// Built with -DPHAGE_PROFILE, every Worker keeps a PhaseProfile: the CPU
+// cycles spent in each phase of a tick (clock pass, finding the sites to
+// visit, deaths and bursts, infection tries, decisions, division, event
+// scheduling, spatial statistics, output) and counts of what happened
+// (visits, births, deaths, bursts, infections, decisions). A PhaseTimer
+// charges the cycles of its scope to one phase; timers nest, and every
+// cycle goes to the innermost phase, so the phases add up to the time
+// spent in the simulation. Cycles come from the time-stamp counter on x86
+// and from the steady clock (in nanoseconds) elsewhere.
+//
+// Without PHAGE_PROFILE, profilingEnabled is false and every timer and
+// count compiles to nothing, so the normal build pays nothing for it.
+/////////////////////////////////////////////////////////////////////////////
+#ifndef PHASE_PROFILER_H
+#define PHASE_PROFILER_H
+
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <ostream>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#ifdef PHAGE_PROFILE
+const bool profilingEnabled = true;
+#else
+const bool profilingEnabled = false;
+#endif
+
+enum Phase { enginePhase, clockPhase, scanPhase, deathPhase, infectionPhase, decisionPhase, divisionPhase, schedulePhase, spatialPhase, outputPhase, phaseCount };
+enum ProfileEvent { tickEvent, visitEvent, birthEvent, deathEvent, burstEvent, infectionTryEvent, infectionEvent, decisionEvent, lysogenyEvent, eventCount };
+
+inline const char *phaseName(int phase)
+{
+    static const char *names[phaseCount] = {"engine", "clock", "scan", "death", "infection", "decision", "division", "schedule", "spatial", "output"};
+    return names[phase];
+}
+
+inline const char *eventName(int event)
+{
+    static const char *names[eventCount] = {"ticks", "visits", "births", "deaths", "bursts", "infectionTries", "infections", "decisions", "lysogenies"};
+    return names[event];
+}
+
+inline uint64_t cycleCounter()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+struct PhaseProfile
+{
+    static const int noPhase = -1; //outside every timer, not charged
+    uint64_t cycles[phaseCount];
+    uint64_t entries[phaseCount]; //times a timer of the phase was started
+    uint64_t events[eventCount];
+    int current; //innermost running phase
+    uint64_t since; //cycle counter when current was last charged
+
+    PhaseProfile() : cycles(), entries(), events(), current(noPhase), since(0) {}
+
+    void count(ProfileEvent event, uint64_t n = 1)
+    {
+        if(profilingEnabled)
+            events[event] += n;
+    }
+
+    int enter(int phase) //charges the running phase and makes phase the running one; returns the phase to go back to
+    {
+        uint64_t now = cycleCounter();
+        if(current != noPhase)
+            cycles[current] += now - since;
+        since = now;
+        int previous = current;
+        current = phase;
+        entries[phase]++;
+        return previous;
+    }
+
+    void leave(int previous)
+    {
+        uint64_t now = cycleCounter();
+        cycles[current] += now - since;
+        since = now;
+        current = previous;
+    }
+
+    void add(const PhaseProfile &other) //the cycles and counts of other, which must not be running
+    {
+        for(int p = 0; p < phaseCount; p++)
+        {
+            cycles[p] += other.cycles[p];
+            entries[p] += other.entries[p];
+        }
+        for(int e = 0; e < eventCount; e++)
+            events[e] += other.events[e];
+    }
+
+    void clear()
+    {
+        *this = PhaseProfile();
+    }
+
+    //one "phase,cycles,share,cyclesPerTick,entries" line per phase and one "event,count,,perTick," line per count, after a header
+    void report(std::ostream &out) const
+    {
+        uint64_t total = 0;
+        for(int p = 0; p < phaseCount; p++)
+            total += cycles[p];
+        double ticks = events[tickEvent] ? events[tickEvent] : 1;
+        out << "name,cycles,share,perTick,entries\n" << std::setprecision(6);
+        for(int p = 0; p < phaseCount; p++)
+            out << phaseName(p) << "," << cycles[p] << "," << (total ? (double)cycles[p]/total : 0) << "," << cycles[p]/ticks << "," << entries[p] << "\n";
+        for(int e = 0; e < eventCount; e++)
+            out << eventName(e) << "," << events[e] << ",," << events[e]/ticks << ",\n";
+    }
+};
+
+class PhaseTimer //charges the cycles of its scope to a phase of profile
+{
+public:
+    PhaseTimer(PhaseProfile &profile, Phase phase) : owner(profile), previous(PhaseProfile::noPhase)
+    {
+        if(profilingEnabled)
+            previous = owner.enter(phase);
+    }
+
+    ~PhaseTimer()
+    {
+        if(profilingEnabled)
+            owner.leave(previous);
+    }
+
+private:
+    PhaseProfile &owner;
+    int previous;
+
+    PhaseTimer(const PhaseTimer &);
+    PhaseTimer &operator=(const PhaseTimer &);
+};
+
+#endif
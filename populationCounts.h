@@ -0,0 +1,48 @@
+/////////////////////////////////////////////////////////////////////////////
+// Population counters of one simulation
+// Kept apart from phageSimulation.h so that the output code (see
+// timeSeriesWriter.h) does not need the whole simulation.
+/////////////////////////////////////////////////////////////////////////////
+#ifndef POPULATION_COUNTS_H
+#define POPULATION_COUNTS_H
+
+const int maxPhageCount = 8; //phages (strategies) that can compete in one simulation: A, B, ... H
+
+struct PopulationCounts //counters keeping track of the numbers
+{
+    long bacteriaCount;
+    long lysogenicBacteriaCount[maxPhageCount]; //by phage, 0 is A
+    long lyticBacteriaCount[maxPhageCount];
+    long deathCount; //counts number of dead bacteria
+    //what a phage without bacteria can still come back from (see runTermination.h); not part of the output
+    long pendingInfections[maxPhageCount]; //sites, empty ones included, where an infection by the phage is still to be tried
+    long pendingDecisions[maxPhageCount]; //healthy bacteria deciding between lysis and lysogeny for the phage
+
+    long healthyBacteriaCount() const
+    {
+        long healthy = bacteriaCount;
+        for(int p = 0; p < maxPhageCount; p++)
+            healthy -= lysogenicBacteriaCount[p] + lyticBacteriaCount[p];
+        return healthy;
+    }
+
+    void add(const PopulationCounts &other)
+    {
+        bacteriaCount += other.bacteriaCount;
+        for(int p = 0; p < maxPhageCount; p++)
+        {
+            lysogenicBacteriaCount[p] += other.lysogenicBacteriaCount[p];
+            lyticBacteriaCount[p] += other.lyticBacteriaCount[p];
+            pendingInfections[p] += other.pendingInfections[p];
+            pendingDecisions[p] += other.pendingDecisions[p];
+        }
+        deathCount += other.deathCount;
+    }
+};
+
+inline char phageLetter(int p) //A for phage 0, B for phage 1, ...; parameter and column names end in it
+{
+    return (char)('A' + p);
+}
+
+#endif
@@ -0,0 +1,119 @@
+/////////////////////////////////////////////////////////////////////////////
+// When a run stops
+// A run always stops at maxTime. Most runs reach an absorbing state long
+// before that -- one phage or all of them gone, or a colony whose counts
+// no longer move -- so a few more criteria can end it early. They are
+// parameters of SimulationParameters, off by default, settable with --set
+// and in sweep configurations:
+//   stopAtSurvivors = N   stop once at most N phages are left. A phage is
+//                         gone when no bacterium carries it and no
+//                         infection or decision of it is pending anywhere
+//                         (seeded infections wait on empty sites too), so
+//                         it can never come back. The pending infections
+//                         and decisions are counted in PopulationCounts as
+//                         they start and end, so this costs nothing per
+//                         tick. -1 (default) never stops.
+//   plateauWindow = W     stop once the bacteria and the lysogenic and lytic
+//   plateauTolerance = f  counts of every phage have stayed within f times
+//                         their largest value (at least 1) over a block of
+//                         W ticks; blocks start at multiples of W. W = 0
+//                         (default) never stops; f defaults to 0.01.
+//   wallClockBudget = s   stop after s seconds of wall-clock time; 0
+//                         (default) for no limit. Unlike the others this
+//                         depends on the machine, not only on the run.
+// RunTermination checks them at the start of every tick, after the tick
+// has been recorded, so the last row of a series is the state the run
+// stopped in. Simulation::run keeps the reason in stopReason.
+/////////////////////////////////////////////////////////////////////////////
+#ifndef RUN_TERMINATION_H
+#define RUN_TERMINATION_H
+
+#include <algorithm>
+#include <chrono>
+#include "populationCounts.h"
+
+enum StopReason { notStopped, timeLimitReached, phagesExtinct, plateauReached, wallClockExceeded };
+
+inline const char *stopReasonName(StopReason reason)
+{
+    static const char *names[] = {"running", "maxTime", "extinction", "plateau", "wallClock"};
+    return names[reason];
+}
+
+class RunTermination
+{
+public:
+    RunTermination() : phageCount(0), survivorsToStop(-1), window(0), tolerance(0), budget(0), blockStart(-1) {}
+
+    //starts watching a run of phages phages with the criteria above; called when the run starts
+    void start(int phages, int stopAtSurvivors, long plateauWindow, double plateauTolerance, double wallClockBudget)
+    {
+        phageCount = phages;
+        survivorsToStop = stopAtSurvivors;
+        window = plateauWindow;
+        tolerance = plateauTolerance;
+        budget = wallClockBudget;
+        blockStart = -1;
+        started = std::chrono::steady_clock::now();
+    }
+
+    StopReason check(long t, const PopulationCounts &population) //whether the run stops at the start of tick t, and why
+    {
+        if(survivorsToStop >= 0 && survivors(population) <= survivorsToStop)
+            return phagesExtinct;
+        if(window > 0 && plateau(t, population))
+            return plateauReached;
+        if(budget > 0 && std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count() >= budget)
+            return wallClockExceeded;
+        return notStopped;
+    }
+
+private:
+    static const int seriesCount = 1 + 2*maxPhageCount; //bacteria, then lysogenic and lytic of every phage
+
+    int phageCount;
+    int survivorsToStop;
+    long window;
+    double tolerance;
+    double budget;
+    std::chrono::steady_clock::time_point started;
+    long blockStart; //first tick of the plateau block, -1 before the first one
+    long low[seriesCount]; //smallest and largest counts in the block so far
+    long high[seriesCount];
+
+    int survivors(const PopulationCounts &population) const //phages still carried by a bacterium or with an infection or decision pending
+    {
+        int left = 0;
+        for(int p = 0; p < phageCount; p++)
+            left += population.lysogenicBacteriaCount[p] || population.lyticBacteriaCount[p] || population.pendingInfections[p] || population.pendingDecisions[p];
+        return left;
+    }
+
+    bool plateau(long t, const PopulationCounts &population)
+    {
+        long counts[seriesCount] = {population.bacteriaCount};
+        for(int p = 0; p < phageCount; p++)
+        {
+            counts[1 + 2*p] = population.lysogenicBacteriaCount[p];
+            counts[2 + 2*p] = population.lyticBacteriaCount[p];
+        }
+        int used = 1 + 2*phageCount;
+        if(blockStart == -1 || t % window == 0) //a new block; the first one starts with the run
+        {
+            blockStart = t;
+            std::copy(counts, counts + used, low);
+            std::copy(counts, counts + used, high);
+            return false;
+        }
+        bool flat = true;
+        for(int n = 0; n < used; n++)
+        {
+            low[n] = std::min(low[n], counts[n]);
+            high[n] = std::max(high[n], counts[n]);
+            flat = flat && high[n] - low[n] <= tolerance*std::max(high[n], 1L);
+        }
+        return flat && t - blockStart + 1 >= window;
+    }
+};
+
+#endif
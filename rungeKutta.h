@@ -0,0 +1,129 @@
+/////////////////////////////////////////////////////////////////////////////
+// Adaptive Runge-Kutta integration of small ODE systems, several at a time
+// The ODE tools (payoffMatrixOde.cpp, moiTournament.cpp) integrate the same
+// system for many parameter values and only need the final state. Lanes
+// holds laneCount doubles, one per copy of the system, and the GCC/Clang
+// vector type makes the arithmetic on it SIMD code (-march=native picks
+// the widest vectors the CPU has; without it the same code is scalar).
+//
+// integrateLanes() is a Dormand-Prince 5(4) stepper with its own step size
+// for every lane: a lane accepts or rejects its step and picks the next
+// one from its own error estimate only, and stops at the end time while
+// the others go on. The result of a lane therefore does not depend on what
+// the other lanes hold, so callers can batch whatever systems are ready
+// without changing any result.
+//
+// A System provides
+//   static const int equationCount;
+//   void derivative(const Lanes *x, Lanes *dx) const;
+/////////////////////////////////////////////////////////////////////////////
+#ifndef RUNGE_KUTTA_H
+#define RUNGE_KUTTA_H
+
+#include <algorithm>
+
+const int laneCount = 8; //systems integrated together; 8 doubles fill an AVX-512 register or two AVX2 ones
+typedef double Lanes __attribute__((vector_size(laneCount*sizeof(double))));
+typedef long LaneMask __attribute__((vector_size(laneCount*sizeof(long)))); //result of comparing Lanes: -1 where true, 0 where false
+
+inline void absolute(Lanes &x)
+{
+    x = x > -x ? x : -x;
+}
+
+//x^-0.1 for x > 0, to about 1%, which is plenty for picking a step size: log2(x) from the exponent bits and a quadratic in the
+//mantissa, then 2^(-0.1 log2(x)) from its integer part in the exponent bits and a quadratic for the rest; no scalar pow per lane
+inline void powMinusTenth(Lanes &x)
+{
+    LaneMask bits = (LaneMask)x;
+    Lanes exponent = __builtin_convertvector(((bits >> 52) & 0x7ff) - 1023, Lanes);
+    Lanes mantissa = (Lanes)((bits & 0xfffffffffffffL) | 0x3ff0000000000000L); //in [1, 2)
+    Lanes y = -0.1*(exponent + (-0.34484843*mantissa + 2.02466578)*mantissa - 1.67487759);
+    Lanes whole = __builtin_convertvector(__builtin_convertvector(y + 1100, LaneMask) - 1100, Lanes); //floor(y) for |y| < 1100
+    Lanes fraction = y - whole;
+    x = (Lanes)((__builtin_convertvector(whole, LaneMask) + 1023) << 52)*(1 + fraction*(0.6565 + 0.344*fraction));
+}
+
+//integrates x from t = 0 to endTime; a step is accepted when its error is below tolerance*|x| + absoluteError in the RMS norm
+//over the equations. steps counts the accepted steps of the lane that needed the most.
+template<class System> void integrateLanes(const System &system, Lanes *x, double endTime, double tolerance, double absoluteError, long &steps)
+{
+    //Dormand-Prince 5(4) tableau; the 5th order weights are the last row of a, so the last stage is the first of the next step
+    static const double a21 = 1.0/5;
+    static const double a31 = 3.0/40, a32 = 9.0/40;
+    static const double a41 = 44.0/45, a42 = -56.0/15, a43 = 32.0/9;
+    static const double a51 = 19372.0/6561, a52 = -25360.0/2187, a53 = 64448.0/6561, a54 = -212.0/729;
+    static const double a61 = 9017.0/3168, a62 = -355.0/33, a63 = 46732.0/5247, a64 = 49.0/176, a65 = -5103.0/18656;
+    static const double a71 = 35.0/384, a73 = 500.0/1113, a74 = 125.0/192, a75 = -2187.0/6784, a76 = 11.0/84;
+    static const double e1 = 71.0/57600, e3 = -71.0/16695, e4 = 71.0/1920, e5 = -17253.0/339200, e6 = 22.0/525, e7 = -1.0/40;
+    const int n = System::equationCount;
+
+    Lanes next[n], stage[n], k1[n], k2[n], k3[n], k4[n], k5[n], k6[n], k7[n];
+    system.derivative(x, k1);
+    Lanes t = {}, h = Lanes{} + 1e-3;
+    LaneMask laneSteps = {};
+    for(;;)
+    {
+        LaneMask running = t < endTime;
+        bool any = false;
+        for(int l = 0; l < laneCount; l++)
+            any = any || running[l];
+        if(!any)
+            break;
+        LaneMask last = t + h >= endTime;
+        h = last ? endTime - t : h;
+        h = running ? h : Lanes{}; //finished lanes take empty steps, which change nothing
+
+        for(int e = 0; e < n; e++)
+            stage[e] = x[e] + h*a21*k1[e];
+        system.derivative(stage, k2);
+        for(int e = 0; e < n; e++)
+            stage[e] = x[e] + h*(a31*k1[e] + a32*k2[e]);
+        system.derivative(stage, k3);
+        for(int e = 0; e < n; e++)
+            stage[e] = x[e] + h*(a41*k1[e] + a42*k2[e] + a43*k3[e]);
+        system.derivative(stage, k4);
+        for(int e = 0; e < n; e++)
+            stage[e] = x[e] + h*(a51*k1[e] + a52*k2[e] + a53*k3[e] + a54*k4[e]);
+        system.derivative(stage, k5);
+        for(int e = 0; e < n; e++)
+            stage[e] = x[e] + h*(a61*k1[e] + a62*k2[e] + a63*k3[e] + a64*k4[e] + a65*k5[e]);
+        system.derivative(stage, k6);
+        for(int e = 0; e < n; e++)
+            next[e] = x[e] + h*(a71*k1[e] + a73*k3[e] + a74*k4[e] + a75*k5[e] + a76*k6[e]);
+        system.derivative(next, k7);
+
+        Lanes error = {}; //mean squared scaled error
+        for(int e = 0; e < n; e++)
+        {
+            Lanes before = x[e], after = next[e];
+            absolute(before);
+            absolute(after);
+            Lanes scaled = h*(e1*k1[e] + e3*k3[e] + e4*k4[e] + e5*k5[e] + e6*k6[e] + e7*k7[e])/(absoluteError + tolerance*(before > after ? before : after));
+            error += scaled*scaled;
+        }
+        error /= n;
+        LaneMask accepted = running & (error <= 1);
+        laneSteps -= accepted;
+        //next step h*0.9/sqrt(error)^0.2, between h/5 and 5h, and not longer after a rejected step
+        Lanes factor = error > 1e-200 ? error : Lanes{} + 1e-200;
+        powMinusTenth(factor);
+        factor *= 0.9;
+        factor = factor > 0.2 ? factor : Lanes{} + 0.2;
+        Lanes longest = accepted ? Lanes{} + 5 : Lanes{} + 1;
+        factor = factor < longest ? factor : longest;
+
+        for(int e = 0; e < n; e++)
+        {
+            x[e] = accepted ? next[e] : x[e];
+            k1[e] = accepted ? k7[e] : k1[e];
+        }
+        t = accepted ? (last ? Lanes{} + endTime : t + h) : t;
+        h *= factor;
+    }
+    steps = 0;
+    for(int l = 0; l < laneCount; l++)
+        steps = std::max(steps, laneSteps[l]);
+}
+
+#endif
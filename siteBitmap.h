@@ -0,0 +1,141 @@
+/////////////////////////////////////////////////////////////////////////////
+// Ordered set of lattice sites, stored as a two-level bitmap
+// One bit per site, plus one summary bit per 64-site word that is set
+// whenever the word is non-empty. next() walks the members in increasing
+// site order, skipping empty stretches 4096 sites at a time, so iterating
+// costs about one step per member on sparse lattices. Members may be added
+// or removed while iterating: a member added ahead of the current position
+// is still visited, exactly like a row-major sweep would see it.
+//
+// insert and erase use atomic read-modify-write operations, so threads
+// working on disjoint sites may update the set concurrently even when their
+// sites share a word (see the parallel engine). After clearing a summary bit
+// erase checks the word again, in case a concurrent insert refilled it.
+/////////////////////////////////////////////////////////////////////////////
+#ifndef SITE_BITMAP_H
+#define SITE_BITMAP_H
+
+#include <cstdint>
+#include <vector>
+
+class SiteBitmap
+{
+public:
+    SiteBitmap() : memberCount(0) {}
+
+    void resize(long siteCount) //removes every member and makes room for sites 0 to siteCount-1
+    {
+        words.assign((siteCount + 63)/64, 0);
+        summary.assign((words.size() + 63)/64, 0);
+        memberCount = 0;
+    }
+
+    void insert(long i)
+    {
+        uint64_t bit = 1ull << (i & 63);
+        uint64_t old = __atomic_fetch_or(&words[i >> 6], bit, __ATOMIC_SEQ_CST);
+        if(old & bit)
+            return;
+        if(!old)
+            __atomic_fetch_or(&summary[i >> 12], 1ull << ((i >> 6) & 63), __ATOMIC_SEQ_CST);
+        __atomic_fetch_add(&memberCount, 1, __ATOMIC_RELAXED);
+    }
+
+    void erase(long i)
+    {
+        uint64_t bit = 1ull << (i & 63);
+        uint64_t old = __atomic_fetch_and(&words[i >> 6], ~bit, __ATOMIC_SEQ_CST);
+        if(!(old & bit))
+            return;
+        if(old == bit) //the word is now empty
+        {
+            uint64_t summaryBit = 1ull << ((i >> 6) & 63);
+            __atomic_fetch_and(&summary[i >> 12], ~summaryBit, __ATOMIC_SEQ_CST);
+            if(__atomic_load_n(&words[i >> 6], __ATOMIC_SEQ_CST))
+                __atomic_fetch_or(&summary[i >> 12], summaryBit, __ATOMIC_SEQ_CST);
+        }
+        __atomic_fetch_sub(&memberCount, 1, __ATOMIC_RELAXED);
+    }
+
+    bool contains(long i) const
+    {
+        return (load(words[i >> 6]) >> (i & 63)) & 1;
+    }
+
+    long next(long i) const //smallest member that is >= i, or -1 if there is none
+    {
+        return next(i, (long)words.size() << 6);
+    }
+
+    long next(long i, long end) const //smallest member in [i, end), or -1 if there is none
+    {
+        if(i >= end)
+            return -1;
+        long w = i >> 6;
+        uint64_t bits = load(words[w]) & (~0ull << (i & 63));
+        if(!bits) //the rest of this word is empty, look for the next non-empty word in the summary
+        {
+            long lastSummary = (end - 1) >> 12;
+            long s = ++w >> 6;
+            if(s > lastSummary)
+                return -1;
+            uint64_t nonEmpty = load(summary[s]) & (~0ull << (w & 63));
+            for(;;)
+            {
+                while(!nonEmpty)
+                {
+                    if(++s > lastSummary)
+                        return -1;
+                    nonEmpty = load(summary[s]);
+                }
+                w = (s << 6) + __builtin_ctzll(nonEmpty);
+                bits = load(words[w]);
+                if(bits)
+                    break;
+                nonEmpty &= nonEmpty - 1; //emptied by a concurrent erase after we read the summary
+            }
+        }
+        long member = (w << 6) + __builtin_ctzll(bits);
+        return member < end ? member : -1;
+    }
+
+    uint64_t word(long i) const //membership bits of the 64 sites of the word holding site i
+    {
+        return load(words[i >> 6]);
+    }
+
+    long count(long begin, long end) const //number of members in [begin, end)
+    {
+        if(begin >= end)
+            return 0;
+        long first = begin >> 6, last = (end - 1) >> 6;
+        long members = 0;
+        for(long w = first; w <= last; w++)
+        {
+            uint64_t bits = load(words[w]);
+            if(w == first)
+                bits &= ~0ull << (begin & 63);
+            if(w == last && (end & 63))
+                bits &= ~(~0ull << (end & 63));
+            members += __builtin_popcountll(bits);
+        }
+        return members;
+    }
+
+    long size() const //number of members
+    {
+        return __atomic_load_n(&memberCount, __ATOMIC_RELAXED);
+    }
+
+private:
+    std::vector<uint64_t> words; //bit i&63 of words[i>>6] is set if site i is a member
+    std::vector<uint64_t> summary; //bit w&63 of summary[w>>6] is set if words[w] is non-zero
+    long memberCount;
+
+    static uint64_t load(const uint64_t &word)
+    {
+        return __atomic_load_n(&word, __ATOMIC_RELAXED);
+    }
+};
+
+#endif
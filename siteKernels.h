@@ -0,0 +1,257 @@
+/////////////////////////////////////////////////////////////////////////////
+// Vector kernels for the per-tick work on runs of sites
+// advance() is the clock pass: it increments the clocks and lytic timers
+// and decrements the birth tickers of a run of sites with masked arithmetic
+// instead of one branch per timer per site. Empty and halo sites have all
+// timers at -1, which the pass leaves alone, so whole runs can be done
+// without looking at the state.
+//
+// due() returns a bitmask of the sites of a run (at most 64) on which
+// updateSite could do anything this tick: a death or burst threshold is
+// reached, a birth window opens, a birth ticker ran out, or a healthy cell
+// is being infected or deciding. Every other occupied site would go
+// through updateSite without changing anything, so the engines only visit
+// the flagged ones. The mask may flag more than needed (updateSite still
+// makes every check) but never less. What each type of cell waits for is
+// set with setType; the birth windows (clock % growthRate == growthRate -
+// birthTimeRange) are found with a multiply-high and a shift in 16 bits.
+//
+// The timers are 8 and 16 bits wide (see cellLattice.h), so an AVX-512
+// register holds 32 clocks or 64 tickers, and an AVX2 one half of that.
+// Which version is used is decided when compiling: -mavx512bw, -mavx2 or
+// -march=native pick the vector code, anything else the scalar loops,
+// which give the same results.
+/////////////////////////////////////////////////////////////////////////////
+#ifndef SITE_KERNELS_H
+#define SITE_KERNELS_H
+
+#include <algorithm>
+#include <cstdint>
+#include "cellLattice.h"
+#include "populationCounts.h"
+#if defined(__AVX512BW__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+enum BirthTicker { noBirthTicker, healthyTicker, infectedTicker }; //which birth ticker a type of cell divides with
+
+class SiteKernels
+{
+public:
+    static const int typeCount = 2 + 2*maxPhageCount; //states 0 (empty), 1 (healthy), then lysogenic and lytic for every phage
+
+    SiteKernels(int clockFoldLimit, int clockFoldPeriod, int birthTimeRange) : foldLimit(clockFoldLimit), foldPeriod(clockFoldPeriod), range(birthTimeRange), typesInUse(1)
+    {
+        for(int t = 0; t < typeCount; t++)
+            setType(t, -1, -1, 0, noBirthTicker, false);
+    }
+
+    //what cells of state type wait for: clock == deathTime, lyticTimer == burstTime (-1: never), a birth window every growthRate ticks
+    //(0: none) with the given ticker, and with infectable the infection tries and the decision countdown
+    void setType(int type, int deathTime, int burstTime, int growthRate, BirthTicker ticker, bool infectable)
+    {
+        death[type] = deathTime < 0 ? -2 : deathTime; //-2 is below every clock and timer, so it never matches
+        burst[type] = burstTime < 0 ? -2 : burstTime;
+        growth[type] = growthRate > 1 ? growthRate : 0; //clock % 1 is never 1 - birthTimeRange, as birthTimeRange < growthRate
+        tickerOf[type] = ticker;
+        tracksInfection[type] = infectable;
+        if(death[type] >= 0 || burst[type] >= 0 || growth[type] || infectable)
+            typesInUse = std::max(typesInUse, type + 1); //the vector loops stop there
+        //x % g for 0 <= x < 2^15: x/g is mulhi(x, multiplier) >> shift, with shift = floor(log2(g - 1)) and multiplier = ceil(2^(16 + shift)/g) < 2^16
+        shift[type] = 0;
+        multiplier[type] = 0;
+        if(growth[type])
+        {
+            while((2 << shift[type]) <= growth[type] - 1)
+                shift[type]++;
+            multiplier[type] = (uint16_t)(((1ul << (16 + shift[type])) + growth[type] - 1)/growth[type]);
+        }
+    }
+
+    void advance(CellLattice &cells, long first, long count) const //one clock pass over the sites [first, first + count)
+    {
+        long n = 0;
+#if defined(__AVX512BW__)
+        const __m512i limit = _mm512_set1_epi16(foldLimit), period = _mm512_set1_epi16(foldPeriod), one = _mm512_set1_epi16(1);
+        for(; n + 32 <= count; n += 32)
+        {
+            int16_t *clock = cells.clockTicks + first + n, *lytic = cells.lyticTimer + first + n;
+            __m512i c = _mm512_loadu_si512(clock);
+            c = _mm512_mask_add_epi16(c, _mm512_cmpneq_epi16_mask(c, _mm512_set1_epi16(-1)), c, one);
+            c = _mm512_mask_sub_epi16(c, _mm512_cmpeq_epi16_mask(c, limit), c, period);
+            _mm512_storeu_si512(clock, c);
+            __m512i l = _mm512_loadu_si512(lytic);
+            _mm512_storeu_si512(lytic, _mm512_mask_add_epi16(l, _mm512_cmpneq_epi16_mask(l, _mm512_set1_epi16(-1)), l, one));
+        }
+        advanceClocks(cells, first, n, count);
+        n = 0;
+        for(; n + 64 <= count; n += 64)
+        {
+            int8_t *tickers[2] = {cells.healthyBirthTicker + first + n, cells.infectedBirthTicker + first + n};
+            for(int p = 0; p < 2; p++)
+            {
+                __m512i b = _mm512_loadu_si512(tickers[p]);
+                _mm512_storeu_si512(tickers[p], _mm512_mask_sub_epi8(b, _mm512_cmpge_epi8_mask(b, _mm512_setzero_si512()), b, _mm512_set1_epi8(1)));
+            }
+        }
+        advanceTickers(cells, first, n, count);
+#elif defined(__AVX2__)
+        const __m256i limit = _mm256_set1_epi16(foldLimit), period = _mm256_set1_epi16(foldPeriod), none = _mm256_set1_epi16(-1);
+        for(; n + 16 <= count; n += 16)
+        {
+            __m256i *clock = (__m256i *)(cells.clockTicks + first + n), *lytic = (__m256i *)(cells.lyticTimer + first + n);
+            __m256i c = _mm256_loadu_si256(clock);
+            c = _mm256_sub_epi16(c, _mm256_andnot_si256(_mm256_cmpeq_epi16(c, none), none)); //subtracting -1 where the clock runs
+            c = _mm256_sub_epi16(c, _mm256_and_si256(_mm256_cmpeq_epi16(c, limit), period));
+            _mm256_storeu_si256(clock, c);
+            __m256i l = _mm256_loadu_si256(lytic);
+            _mm256_storeu_si256(lytic, _mm256_sub_epi16(l, _mm256_andnot_si256(_mm256_cmpeq_epi16(l, none), none)));
+        }
+        advanceClocks(cells, first, n, count);
+        n = 0;
+        for(; n + 32 <= count; n += 32)
+        {
+            __m256i *tickers[2] = {(__m256i *)(cells.healthyBirthTicker + first + n), (__m256i *)(cells.infectedBirthTicker + first + n)};
+            for(int p = 0; p < 2; p++)
+            {
+                __m256i b = _mm256_loadu_si256(tickers[p]);
+                _mm256_storeu_si256(tickers[p], _mm256_add_epi8(b, _mm256_cmpgt_epi8(b, _mm256_set1_epi8(-1)))); //adding -1 where the ticker runs
+            }
+        }
+        advanceTickers(cells, first, n, count);
+#else
+        advanceClocks(cells, first, n, count);
+        advanceTickers(cells, first, n, count);
+#endif
+    }
+
+    uint64_t due(const CellLattice &cells, long first, long count) const //bit n is set if site first + n may have something to do this tick; count <= 64
+    {
+        uint64_t mask = 0;
+        long n = 0;
+#if defined(__AVX512BW__)
+        for(; n + 32 <= count; n += 32)
+        {
+            long i = first + n;
+            __m512i state = _mm512_cvtepu8_epi16(_mm256_loadu_si256((const __m256i *)(cells.state + i)));
+            __m512i infection = _mm512_cvtepi8_epi16(_mm256_loadu_si256((const __m256i *)(cells.infectionStatus + i)));
+            __m512i tickers[3] = {_mm512_setzero_si512(), _mm512_cvtepi8_epi16(_mm256_loadu_si256((const __m256i *)(cells.healthyBirthTicker + i))),
+                                  _mm512_cvtepi8_epi16(_mm256_loadu_si256((const __m256i *)(cells.infectedBirthTicker + i)))};
+            __m512i clock = _mm512_loadu_si512(cells.clockTicks + i), lytic = _mm512_loadu_si512(cells.lyticTimer + i), decision = _mm512_cvtepi8_epi16(_mm256_loadu_si256((const __m256i *)(cells.decisionState + i)));
+            __mmask32 running = _mm512_cmpneq_epi16_mask(clock, _mm512_setzero_si512());
+            __mmask32 flagged = 0;
+            for(int t = 1; t < typesInUse; t++)
+            {
+                __mmask32 is = _mm512_cmpeq_epi16_mask(state, _mm512_set1_epi16(t));
+                if(!is)
+                    continue;
+                __mmask32 cond = _mm512_cmpeq_epi16_mask(clock, _mm512_set1_epi16(death[t])) | _mm512_cmpeq_epi16_mask(lytic, _mm512_set1_epi16(burst[t]));
+                if(growth[t])
+                {
+                    __m512i quotient = _mm512_srl_epi16(_mm512_mulhi_epu16(clock, _mm512_set1_epi16(multiplier[t])), _mm_cvtsi32_si128(shift[t]));
+                    __m512i remainder = _mm512_sub_epi16(clock, _mm512_mullo_epi16(quotient, _mm512_set1_epi16(growth[t])));
+                    const __m512i &ticker = tickers[tickerOf[t]];
+                    cond |= _mm512_cmpeq_epi16_mask(ticker, _mm512_setzero_si512());
+                    cond |= _mm512_cmpeq_epi16_mask(ticker, _mm512_set1_epi16(-1)) & running & _mm512_cmpeq_epi16_mask(remainder, _mm512_set1_epi16(growth[t] - range));
+                }
+                if(tracksInfection[t])
+                    cond |= _mm512_cmpneq_epi16_mask(infection, _mm512_setzero_si512()) | _mm512_cmpneq_epi16_mask(decision, _mm512_setzero_si512());
+                flagged |= is & cond;
+            }
+            mask |= (uint64_t)flagged << n;
+        }
+#elif defined(__AVX2__)
+        const __m256i zero = _mm256_setzero_si256();
+        for(; n + 16 <= count; n += 16)
+        {
+            long i = first + n;
+            __m256i state = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(cells.state + i)));
+            __m256i infection = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i *)(cells.infectionStatus + i)));
+            __m256i tickers[3] = {zero, _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i *)(cells.healthyBirthTicker + i))),
+                                  _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i *)(cells.infectedBirthTicker + i)))};
+            __m256i clock = _mm256_loadu_si256((const __m256i *)(cells.clockTicks + i)), lytic = _mm256_loadu_si256((const __m256i *)(cells.lyticTimer + i));
+            __m256i decision = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i *)(cells.decisionState + i)));
+            __m256i stopped = _mm256_cmpeq_epi16(clock, zero);
+            __m256i flagged = zero;
+            for(int t = 1; t < typesInUse; t++)
+            {
+                __m256i is = _mm256_cmpeq_epi16(state, _mm256_set1_epi16(t));
+                if(_mm256_testz_si256(is, is))
+                    continue;
+                __m256i cond = _mm256_or_si256(_mm256_cmpeq_epi16(clock, _mm256_set1_epi16(death[t])), _mm256_cmpeq_epi16(lytic, _mm256_set1_epi16(burst[t])));
+                if(growth[t])
+                {
+                    __m256i quotient = _mm256_srl_epi16(_mm256_mulhi_epu16(clock, _mm256_set1_epi16(multiplier[t])), _mm_cvtsi32_si128(shift[t]));
+                    __m256i remainder = _mm256_sub_epi16(clock, _mm256_mullo_epi16(quotient, _mm256_set1_epi16(growth[t])));
+                    const __m256i &ticker = tickers[tickerOf[t]];
+                    __m256i window = _mm256_and_si256(_mm256_cmpeq_epi16(ticker, _mm256_set1_epi16(-1)), _mm256_cmpeq_epi16(remainder, _mm256_set1_epi16(growth[t] - range)));
+                    cond = _mm256_or_si256(cond, _mm256_or_si256(_mm256_cmpeq_epi16(ticker, zero), _mm256_andnot_si256(stopped, window)));
+                }
+                if(tracksInfection[t])
+                    cond = _mm256_or_si256(cond, _mm256_andnot_si256(_mm256_and_si256(_mm256_cmpeq_epi16(infection, zero), _mm256_cmpeq_epi16(decision, zero)), _mm256_set1_epi16(-1)));
+                flagged = _mm256_or_si256(flagged, _mm256_and_si256(is, cond));
+            }
+            __m128i packed = _mm_packs_epi16(_mm256_castsi256_si128(flagged), _mm256_extracti128_si256(flagged, 1)); //one byte per site, in order
+            mask |= (uint64_t)(uint32_t)_mm_movemask_epi8(packed) << n;
+        }
+#endif
+        for(; n < count; n++)
+            if(dueSite(cells, first + n))
+                mask |= 1ull << n;
+        return mask;
+    }
+
+private:
+    int foldLimit, foldPeriod, range;
+    int typesInUse; //states above have nothing to wait for
+    int16_t death[typeCount];
+    int16_t burst[typeCount];
+    int16_t growth[typeCount];
+    BirthTicker tickerOf[typeCount];
+    bool tracksInfection[typeCount];
+    int shift[typeCount];
+    uint16_t multiplier[typeCount];
+
+    void advanceClocks(CellLattice &cells, long first, long from, long count) const //the clocks and lytic timers of sites first + [from, count)
+    {
+        for(long n = from; n < count; n++)
+        {
+            int16_t c = cells.clockTicks[first + n];
+            c += (c != -1);
+            c -= (c == foldLimit)*foldPeriod;
+            cells.clockTicks[first + n] = c;
+            cells.lyticTimer[first + n] += (cells.lyticTimer[first + n] != -1);
+        }
+    }
+
+    void advanceTickers(CellLattice &cells, long first, long from, long count) const
+    {
+        for(long n = from; n < count; n++)
+        {
+            cells.healthyBirthTicker[first + n] -= (cells.healthyBirthTicker[first + n] >= 0);
+            cells.infectedBirthTicker[first + n] -= (cells.infectedBirthTicker[first + n] >= 0);
+        }
+    }
+
+    bool dueSite(const CellLattice &cells, long i) const
+    {
+        int t = cells.state[i];
+        if(t >= typeCount || !t) //empty or halo
+            return false;
+        int clock = cells.clockTicks[i];
+        if(clock == death[t] || cells.lyticTimer[i] == burst[t])
+            return true;
+        if(growth[t])
+        {
+            int ticker = (tickerOf[t] == healthyTicker) ? cells.healthyBirthTicker[i] : cells.infectedBirthTicker[i];
+            if(ticker == 0 || (ticker == -1 && clock != 0 && clock % growth[t] == growth[t] - range))
+                return true;
+        }
+        return tracksInfection[t] && (cells.infectionStatus[i] || cells.decisionState[i]);
+    }
+
+    SiteKernels(const SiteKernels &);
+    SiteKernels &operator=(const SiteKernels &);
+};
+
+#endif
@@ -0,0 +1,138 @@
+/////////////////////////////////////////////////////////////////////////////
+// Reader for the snapshot streams written with --snapshots
+// (see snapshotStream.h for the format)
+//
+// Usage: snapshotReader file              lists the frames and the compression
+//        snapshotReader file --counts     number of sites in every state, one CSV line per frame
+//        snapshotReader file T            prints the lattice at the last frame at or before tick T,
+//                                         one row per line (0 empty, 1 healthy, 2/4/... lysogenic A/B/..., 3/5/... lytic A/B/...)
+//        snapshotReader file T --pgm out  writes that frame as a greyscale PGM image instead
+//
+// Build: g++ -O3 -std=c++17 -o snapshotReader snapshotReader.cpp
+/////////////////////////////////////////////////////////////////////////////
+#include <iostream>
+#include <fstream>
+#include <cstdlib>
+#include <string>
+#include "snapshotStream.h"
+#include "populationCounts.h"
+
+using namespace std;
+
+int listFrames(SnapshotReader &reader)
+{
+    cout << "lattice " << reader.size << " x " << reader.size << ", a frame every " << reader.every << " ticks, a keyframe every " << reader.keyframeEvery << " frames" << endl;
+    long frames = 0, keyframes = 0, bytes = 0;
+    bool keyframe;
+    long payloadBytes;
+    int status;
+    while((status = reader.next(false, &keyframe, &payloadBytes)) == 1)
+    {
+        cout << reader.tick << (keyframe ? " keyframe " : " delta ") << payloadBytes << " bytes" << endl;
+        frames++;
+        keyframes += keyframe;
+        bytes += payloadBytes + snapshotCodec::frameHeaderBytes;
+    }
+    double raw = (double)frames*reader.size*reader.size;
+    cout << frames << " frames (" << keyframes << " keyframes), " << bytes << " bytes, " << (bytes ? raw/bytes : 0) << " times smaller than the raw planes" << endl;
+    if(status < 0)
+        cerr << "The stream is damaged after tick " << reader.tick << "." << endl;
+    return status < 0;
+}
+
+int phagesIn(const vector<uint8_t> &plane) //phages whose states occur in plane, at least the 2 of the paper
+{
+    int phages = 2;
+    for(size_t i = 0; i < plane.size(); i++)
+        if(plane[i] >= 2 && plane[i] < 2 + 2*maxPhageCount)
+            phages = max(phages, (plane[i] - 2)/2 + 1);
+    return phages;
+}
+
+int countStates(SnapshotReader &reader)
+{
+    int phages = 2, status; //the stream does not say how many phages competed, so a first pass looks for their states
+    while((status = reader.next()) == 1)
+        phages = max(phages, phagesIn(reader.plane));
+    if(status < 0 || !reader.rewind())
+    {
+        cerr << "The stream is damaged after tick " << reader.tick << "." << endl;
+        return 1;
+    }
+
+    cout << "t,empty,healthy";
+    for(int p = 0; p < phages; p++)
+        cout << ",lysogenic" << phageLetter(p) << ",lytic" << phageLetter(p);
+    cout << "\n";
+    while((status = reader.next()) == 1)
+    {
+        long counts[2 + 2*maxPhageCount] = {0};
+        for(size_t i = 0; i < reader.plane.size(); i++)
+            if(reader.plane[i] < 2 + 2*phages)
+                counts[reader.plane[i]]++;
+        cout << reader.tick;
+        for(int s = 0; s < 2 + 2*phages; s++)
+            cout << "," << counts[s];
+        cout << "\n";
+    }
+    if(status < 0)
+        cerr << "The stream is damaged after tick " << reader.tick << "." << endl;
+    return status < 0;
+}
+
+int printFrame(SnapshotReader &reader, long t, const string &pgmFile)
+{
+    int status = reader.seek(t);
+    if(status != 1)
+    {
+        cerr << (status ? "The stream is damaged." : "There is no frame at or before that tick.") << endl;
+        return 1;
+    }
+    if(pgmFile.empty())
+    {
+        cout << "Time: " << reader.tick << endl;
+        for(long j = 0; j < reader.size; j++)
+        {
+            for(long k = 0; k < reader.size; k++)
+                cout << (int)reader.plane[j*reader.size + k] << (k + 1 < reader.size ? " " : "\n");
+        }
+        return 0;
+    }
+
+    //empty black, healthy white, the lysogenic and lytic states of the phages in shades of grey from 200 down to 50
+    int phages = phagesIn(reader.plane);
+    unsigned char grey[2 + 2*maxPhageCount] = {0, 255};
+    for(int s = 2; s < 2 + 2*phages; s++)
+        grey[s] = 200 - (s - 2)*150/(2*phages - 1);
+    ofstream image(pgmFile.c_str(), ios::out | ios::binary);
+    image << "P5\n" << reader.size << " " << reader.size << "\n255\n";
+    for(size_t i = 0; i < reader.plane.size(); i++)
+        image.put(reader.plane[i] < 2 + 2*phages ? grey[reader.plane[i]] : 0);
+    if(!image)
+    {
+        cerr << "Cannot write " << pgmFile << "." << endl;
+        return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    if(argc < 2 || argc > 5 || (argc == 5 && string(argv[3]) != "--pgm") || argc == 4)
+    {
+        cerr << "Usage: " << argv[0] << " file [--counts | T [--pgm out.pgm]]" << endl;
+        return 1;
+    }
+    SnapshotReader reader;
+    string error = reader.open(argv[1]);
+    if(!error.empty())
+    {
+        cerr << error << endl;
+        return 1;
+    }
+    if(argc == 2)
+        return listFrames(reader);
+    if(string(argv[2]) == "--counts")
+        return countStates(reader);
+    return printFrame(reader, atol(argv[2]), argc == 5 ? argv[4] : "");
+}
@@ -0,0 +1,401 @@
+/////////////////////////////////////////////////////////////////////////////
+// Compressed stream of lattice snapshots
+// SnapshotWriter records the state plane (0 empty, 1 healthy, 2/4/...
+// lysogenic A/B/..., 3/5/... lytic A/B/...) every K ticks. Each frame is
+// the 8-bit plane XORed with the previous frame, so sites that did not
+// change become zeros, and then run-length encoded. Every keyframeEvery-th
+// frame stores the plane itself instead, so a reader can start there. The
+// simulation thread only copies the plane; XOR, encoding and writing happen
+// on a background thread, which lags at most one frame behind.
+//
+// SnapshotReader decodes such a file frame by frame (see snapshotReader.cpp
+// for a standalone tool).
+//
+// File layout (little-endian):
+//   header, 32 bytes:
+//     char     magic[8]        "PHAGESS\0"
+//     uint32   version         1
+//     uint32   latticeSize     frames are latticeSize x latticeSize, row-major
+//     uint32   every           ticks between frames
+//     uint32   keyframeEvery   frames between keyframes
+//     uint64   frameCount      written on close (0 if the run was cut short)
+//   then for every frame:
+//     int64    tick
+//     uint32   flags           1 for a keyframe, 0 for a delta against the previous frame
+//     uint32   payloadBytes
+//     payload: a sequence of tokens, each a varint (LEB128) c:
+//              c % 2 == 1: one byte of value c/2 (one byte long for values below 64)
+//              c % 4 == 0: c/4 zero bytes
+//              c % 4 == 2: c/4 copies of the byte that follows
+//              Sites that change between frames are mostly isolated, so a delta
+//              costs about one byte per changed site plus one per gap.
+/////////////////////////////////////////////////////////////////////////////
+#ifndef SNAPSHOT_STREAM_H
+#define SNAPSHOT_STREAM_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "cellLattice.h"
+
+namespace snapshotCodec
+{
+    const char magic[8] = "PHAGESS";
+    const uint32_t version = 1;
+    const long headerBytes = 32;
+    const long frameHeaderBytes = 16;
+    const long minRun = 3; //shorter runs of a non-zero byte are cheaper as single bytes
+
+    inline void putVarint(std::vector<uint8_t> &out, uint64_t value)
+    {
+        while(value >= 0x80)
+        {
+            out.push_back((uint8_t)(value | 0x80));
+            value >>= 7;
+        }
+        out.push_back((uint8_t)value);
+    }
+
+    inline bool getVarint(const uint8_t *&in, const uint8_t *end, uint64_t &value)
+    {
+        value = 0;
+        for(int shift = 0; in < end && shift < 64; shift += 7)
+        {
+            uint8_t byte = *in++;
+            value |= (uint64_t)(byte & 0x7f) << shift;
+            if(!(byte & 0x80))
+                return true;
+        }
+        return false;
+    }
+
+    inline void encode(const uint8_t *plane, long n, std::vector<uint8_t> &out) //appends the encoding of plane[0..n) to out
+    {
+        long i = 0;
+        while(i < n)
+        {
+            long run = 1;
+            while(i + run < n && plane[i + run] == plane[i])
+                run++;
+            if(!plane[i])
+                putVarint(out, (uint64_t)run << 2);
+            else if(run >= minRun)
+            {
+                putVarint(out, ((uint64_t)run << 2) | 2);
+                out.push_back(plane[i]);
+            }
+            else
+                for(long r = 0; r < run; r++)
+                    putVarint(out, ((uint64_t)plane[i] << 1) | 1);
+            i += run;
+        }
+    }
+
+    inline bool decode(const uint8_t *in, long bytes, uint8_t *plane, long n) //inverse of encode; false if the payload does not describe exactly n bytes
+    {
+        const uint8_t *end = in + bytes;
+        long i = 0;
+        while(in < end)
+        {
+            uint64_t control;
+            if(!getVarint(in, end, control))
+                return false;
+            if(control & 1)
+            {
+                if(i == n || control >> 1 > 255)
+                    return false;
+                plane[i++] = (uint8_t)(control >> 1);
+                continue;
+            }
+            uint64_t length = control >> 2;
+            if(length > (uint64_t)(n - i))
+                return false;
+            uint8_t value = 0;
+            if(control & 2)
+            {
+                if(in == end)
+                    return false;
+                value = *in++;
+            }
+            memset(plane + i, value, length);
+            i += length;
+        }
+        return i == n;
+    }
+}
+
+class SnapshotWriter
+{
+public:
+    SnapshotWriter() : file(0), size(0), every(1), keyframeEvery(64), frameCount(0), captured(false), capturedTick(0), stopping(false), failed(false) {}
+
+    ~SnapshotWriter()
+    {
+        close();
+    }
+
+    bool open(const std::string &fileName, long latticeSize, long everyTicks, long keyframes = 64) //starts a stream of latticeSize x latticeSize frames, one every everyTicks ticks
+    {
+        close();
+        file = fopen(fileName.c_str(), "wb");
+        if(!file)
+            return false;
+        size = latticeSize;
+        every = everyTicks < 1 ? 1 : everyTicks;
+        keyframeEvery = keyframes < 1 ? 1 : keyframes;
+        frameCount = 0;
+        captured = false;
+        stopping = false;
+        failed = false;
+        capture.assign(size*size, 0);
+        current.assign(size*size, 0);
+        previous.assign(size*size, 0);
+
+        uint8_t header[snapshotCodec::headerBytes] = {0};
+        uint32_t fields[4] = {snapshotCodec::version, (uint32_t)size, (uint32_t)every, (uint32_t)keyframeEvery};
+        memcpy(header, snapshotCodec::magic, 8);
+        memcpy(header + 8, fields, sizeof(fields));
+        if(fwrite(header, 1, sizeof(header), file) != sizeof(header))
+            failed = true;
+        encoder = std::thread(&SnapshotWriter::encoderLoop, this);
+        return true;
+    }
+
+    void record(long t, const CellLattice &cells) //called at the start of every tick; copies the state plane if a frame is due
+    {
+        if(!file || t % every)
+            return;
+        std::unique_lock<std::mutex> guard(lock);
+        encoderReady.wait(guard, [this] { return !captured; }); //the encoder is still on the frame before the previous one
+        for(long j = 0; j < size; j++)
+            memcpy(&capture[j*size], &cells.state[cells.index(j, 0)], size);
+        capturedTick = t;
+        captured = true;
+        guard.unlock();
+        frameReady.notify_all();
+    }
+
+    bool close() //encodes the last frame and closes the file; false if anything could not be written
+    {
+        if(!file)
+            return !failed;
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            stopping = true;
+        }
+        frameReady.notify_all();
+        encoder.join();
+        uint64_t frames = frameCount;
+        if(!failed && (fseek(file, 24, SEEK_SET) != 0 || fwrite(&frames, sizeof(frames), 1, file) != 1))
+            failed = true;
+        failed = (fclose(file) != 0) || failed;
+        file = 0;
+        return !failed;
+    }
+
+private:
+    FILE *file;
+    long size;
+    long every;
+    long keyframeEvery;
+    long frameCount;
+
+    std::vector<uint8_t> capture; //plane copied by record, waiting for the encoder
+    bool captured; //capture holds a frame the encoder has not taken yet
+    long capturedTick;
+    std::vector<uint8_t> current; //frames owned by the encoder thread
+    std::vector<uint8_t> previous;
+    std::vector<uint8_t> delta;
+    std::vector<uint8_t> payload;
+    std::thread encoder;
+    std::mutex lock;
+    std::condition_variable frameReady;
+    std::condition_variable encoderReady;
+    bool stopping;
+    bool failed;
+
+    void encoderLoop()
+    {
+        for(;;)
+        {
+            long tick;
+            {
+                std::unique_lock<std::mutex> guard(lock);
+                frameReady.wait(guard, [this] { return stopping || captured; });
+                if(!captured)
+                    return;
+                current.swap(capture);
+                tick = capturedTick;
+                captured = false;
+            }
+            encoderReady.notify_all();
+
+            long n = size*size;
+            bool keyframe = frameCount % keyframeEvery == 0;
+            payload.clear();
+            if(keyframe)
+                snapshotCodec::encode(&current[0], n, payload);
+            else
+            {
+                delta.resize(n);
+                for(long i = 0; i < n; i++)
+                    delta[i] = current[i] ^ previous[i];
+                snapshotCodec::encode(&delta[0], n, payload);
+            }
+            int64_t frameTick = tick;
+            uint32_t fields[2] = {keyframe ? 1u : 0u, (uint32_t)payload.size()};
+            bool ok = fwrite(&frameTick, sizeof(frameTick), 1, file) == 1 && fwrite(fields, sizeof(fields), 1, file) == 1
+                   && fwrite(&payload[0], 1, payload.size(), file) == payload.size();
+            if(!ok)
+                failed = true; //only read by close, after the join
+            previous.swap(current);
+            frameCount++;
+        }
+    }
+
+    SnapshotWriter(const SnapshotWriter &);
+    SnapshotWriter &operator=(const SnapshotWriter &);
+};
+
+class SnapshotReader
+{
+public:
+    long size; //from the file header
+    long every;
+    long keyframeEvery;
+    long frameCount; //0 if the writer did not close the file
+    long tick; //tick of the frame last read
+    std::vector<uint8_t> plane; //state plane of the frame last read, row-major
+
+    SnapshotReader() : size(0), every(0), keyframeEvery(0), frameCount(0), tick(-1), file(0), haveFrame(false) {}
+
+    ~SnapshotReader()
+    {
+        if(file)
+            fclose(file);
+    }
+
+    std::string open(const std::string &fileName) //reads the header; returns what is wrong with the file, or an empty string
+    {
+        file = fopen(fileName.c_str(), "rb");
+        if(!file)
+            return "Cannot open " + fileName + ".";
+        uint8_t header[snapshotCodec::headerBytes];
+        if(fread(header, 1, sizeof(header), file) != sizeof(header) || memcmp(header, snapshotCodec::magic, 8) != 0)
+            return fileName + " is not a snapshot stream.";
+        uint32_t fields[4];
+        uint64_t frames;
+        memcpy(fields, header + 8, sizeof(fields));
+        memcpy(&frames, header + 24, sizeof(frames));
+        if(fields[0] != snapshotCodec::version)
+            return fileName + " has an unknown version.";
+        size = fields[1];
+        every = fields[2];
+        keyframeEvery = fields[3];
+        frameCount = frames;
+        plane.assign(size*size, 0);
+        return "";
+    }
+
+    //reads the next frame into plane and tick; returns 1 if there is one, 0 at the end of the stream and -1 if the file is damaged.
+    //With decodeFrame false the payload is skipped, and the deltas that follow cannot be decoded before the next keyframe.
+    int next(bool decodeFrame = true, bool *keyframe = 0, long *payloadBytes = 0)
+    {
+        int64_t frameTick;
+        uint32_t fields[2];
+        if(fread(&frameTick, sizeof(frameTick), 1, file) != 1)
+            return 0;
+        if(fread(fields, sizeof(fields), 1, file) != 1)
+            return -1;
+        tick = frameTick;
+        if(keyframe)
+            *keyframe = fields[0] & 1;
+        if(payloadBytes)
+            *payloadBytes = fields[1];
+        if(!decodeFrame)
+        {
+            haveFrame = false;
+            return fseek(file, fields[1], SEEK_CUR) == 0 ? 1 : -1;
+        }
+        if(!(fields[0] & 1) && !haveFrame)
+            return -1; //a delta needs the frame before it
+        payload.resize(fields[1]);
+        if(fields[1] && fread(&payload[0], 1, fields[1], file) != fields[1])
+            return -1;
+        long n = size*size;
+        if(fields[0] & 1)
+        {
+            if(!snapshotCodec::decode(payload.empty() ? 0 : &payload[0], payload.size(), &plane[0], n))
+                return -1;
+        }
+        else
+        {
+            delta.resize(n);
+            if(!snapshotCodec::decode(payload.empty() ? 0 : &payload[0], payload.size(), &delta[0], n))
+                return -1;
+            for(long i = 0; i < n; i++)
+                plane[i] ^= delta[i];
+        }
+        haveFrame = true;
+        return 1;
+    }
+
+    bool rewind() //goes back to before the first frame
+    {
+        tick = -1;
+        haveFrame = false;
+        return fseek(file, snapshotCodec::headerBytes, SEEK_SET) == 0;
+    }
+
+    int seek(long wantedTick) //decodes frames up to the last one at or before wantedTick, starting from the keyframe before it; 1 if found
+    {
+        long keyframeOffset = -1; //skip frames without decoding until the last keyframe before wantedTick
+        if(fseek(file, snapshotCodec::headerBytes, SEEK_SET) != 0)
+            return -1;
+        for(;;)
+        {
+            long offset = ftell(file);
+            int64_t frameTick;
+            uint32_t fields[2];
+            if(fread(&frameTick, sizeof(frameTick), 1, file) != 1 || fread(fields, sizeof(fields), 1, file) != 1 || frameTick > wantedTick)
+                break;
+            if(fields[0] & 1)
+                keyframeOffset = offset;
+            if(fseek(file, fields[1], SEEK_CUR) != 0)
+                return -1;
+        }
+        if(keyframeOffset == -1 || fseek(file, keyframeOffset, SEEK_SET) != 0)
+            return 0;
+        haveFrame = false;
+        for(;;)
+        {
+            long offset = ftell(file);
+            int64_t frameTick;
+            if(fread(&frameTick, sizeof(frameTick), 1, file) != 1 || frameTick > wantedTick)
+            {
+                fseek(file, offset, SEEK_SET); //the next call of next() reads the frame after the one found
+                return 1;
+            }
+            fseek(file, offset, SEEK_SET);
+            int status = next();
+            if(status != 1)
+                return status;
+        }
+    }
+
+private:
+    FILE *file;
+    bool haveFrame;
+    std::vector<uint8_t> payload;
+    std::vector<uint8_t> delta;
+
+    SnapshotReader(const SnapshotReader &);
+    SnapshotReader &operator=(const SnapshotReader &);
+};
+
+#endif
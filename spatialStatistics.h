@@ -0,0 +1,442 @@
+/////////////////////////////////////////////////////////////////////////////
+// Spatial statistics of the lysogen domains, kept up to date tick by tick
+// A domain is a set of lysogens of the same phage connected through their
+// four nearest neighbours (across the edges too with periodic boundaries).
+// SpatialStatistics follows the domain of every site and the number of
+// pairs of lysogens at each distance, and is told about every site whose
+// lysogen status changes (set), so the statistics of a tick cost about as
+// much as the changes in it instead of a relabelling of the whole lattice:
+//   - Domains are the trees of a union-find forest over labels. A new
+//     lysogen joins the domains of its neighbours, merging them (union by
+//     size). When a lysogen goes away its neighbours of the same phage are
+//     searched from breadth first, in turns; searches that meet are joined,
+//     and as soon as at most one of them is still going, every search that
+//     ran out is a piece that split off and gets a new label. A site whose
+//     neighbours stay connected around it is therefore done in a few steps,
+//     and a split costs about the size of the smaller pieces.
+//   - Labels that were split off leave unused nodes behind. Once there are
+//     twice as many nodes as sites the lattice is relabelled from scratch
+//     with one Hoshen-Kopelman pass.
+//   - pairs counts the pairs of lysogens of phages (a, b) that are r sites
+//     apart along a row or a column, r = 1 to range. A change updates the
+//     4*range pairs of its site. The pairs at r = 1 of different phages
+//     are the bonds of the interface between their domains.
+// writeRow prints one CSV line of these: per phage the number of domains,
+// the largest and a histogram of their sizes in powers of two, the length
+// of every interface, and the pair correlation functions
+//   g_ab(r) = pairs_ab(r) / (pairs of sites at distance r * expected fraction of them with phages a and b)
+// which are 1 for lysogens placed at random and above 1 where they cluster.
+/////////////////////////////////////////////////////////////////////////////
+#ifndef SPATIAL_STATISTICS_H
+#define SPATIAL_STATISTICS_H
+
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <vector>
+#include "populationCounts.h"
+
+const int defaultCorrelationRange = 8; //largest distance of the pair correlations unless one is asked for
+
+class SpatialStatistics
+{
+public:
+    SpatialStatistics() : side(0), siteCount(0), periodic(false), phageCount(0), range(0), stamp(0) {}
+
+    bool tracking() const //start has been called
+    {
+        return side > 0;
+    }
+
+    //starts over on an empty side x side lattice with phages phages, and pair correlations up to correlationRange sites
+    //(at most half the side); the lysogens are then added with set
+    void start(long latticeSide, bool periodicBoundary, int phages, int correlationRange)
+    {
+        side = latticeSide;
+        siteCount = side*side;
+        periodic = periodicBoundary;
+        phageCount = phages;
+        range = std::max(1, std::min<int>(correlationRange, (side - 1)/2));
+        kind.assign(siteCount, 0);
+        label.assign(siteCount, -1);
+        visitStamp.assign(siteCount, 0);
+        visitOwner.assign(siteCount, 0);
+        lysogens.assign(phageCount + 1, 0);
+        lysogens[0] = siteCount;
+        pairs.assign(phageCount*phageCount*range, 0);
+        relabel();
+    }
+
+    //site (row*side + column) now holds a lysogen of phage newKind - 1, or none if newKind is 0; setting the kind it already has does nothing
+    void set(long site, int newKind)
+    {
+        int oldKind = kind[site];
+        if(newKind == oldKind)
+            return;
+        countPairs(site, oldKind, -1);
+        kind[site] = newKind;
+        countPairs(site, newKind, 1);
+        lysogens[oldKind]--;
+        lysogens[newKind]++;
+        if(oldKind)
+            leave(site, oldKind);
+        if(newKind)
+            join(site, newKind);
+        if((long)parent.size() > 2*siteCount + 64)
+            relabel();
+    }
+
+    long domainCount(int phage) const
+    {
+        long count = 0;
+        for(std::map<long, long>::const_iterator s = sizes[phage].begin(); s != sizes[phage].end(); ++s)
+            count += s->second;
+        return count;
+    }
+
+    long largestDomain(int phage) const
+    {
+        return sizes[phage].empty() ? 0 : sizes[phage].rbegin()->first;
+    }
+
+    const std::map<long, long> &domainSizes(int phage) const //number of domains of every size
+    {
+        return sizes[phage];
+    }
+
+    long pairCount(int phageA, int phageB, int r) const //pairs of lysogens of phageA and phageB r sites apart along a row or column
+    {
+        return pairs[pairIndex(phageA + 1, phageB + 1, r)];
+    }
+
+    long interfaceLength(int phageA, int phageB) const //nearest-neighbour bonds between lysogens of two different phages
+    {
+        return pairCount(phageA, phageB, 1);
+    }
+
+    double correlation(int phageA, int phageB, int r) const //g_ab(r), see the top of the file; 0 while either phage has no lysogens
+    {
+        double sitePairs = 2.0*side*(periodic ? side : side - r);
+        double expected = sitePairs*lysogens[phageA + 1]*lysogens[phageB + 1]/((double)siteCount*siteCount)*(phageA == phageB ? 1 : 2);
+        return expected > 0 ? pairCount(phageA, phageB, r)/expected : 0;
+    }
+
+    void writeHeader(std::ostream &out) const
+    {
+        out << "t";
+        for(int p = 0; p < phageCount; p++)
+            out << ",domains" << phageLetter(p) << ",largestDomain" << phageLetter(p);
+        for(int p = 0; p < phageCount; p++)
+            for(int q = p + 1; q < phageCount; q++)
+                out << ",interface" << phageLetter(p) << phageLetter(q);
+        for(int p = 0; p < phageCount; p++)
+            for(long size = 1; size <= siteCount; size *= 2)
+                out << ",domains" << phageLetter(p) << "_" << size; //sizes size to 2*size - 1
+        for(int p = 0; p < phageCount; p++)
+            for(int q = p; q < phageCount; q++)
+                for(int r = 1; r <= range; r++)
+                    out << ",g" << phageLetter(p) << phageLetter(q) << "_" << r;
+        out << "\n";
+    }
+
+    void writeRow(std::ostream &out, long t) const
+    {
+        out << t;
+        for(int p = 0; p < phageCount; p++)
+            out << "," << domainCount(p) << "," << largestDomain(p);
+        for(int p = 0; p < phageCount; p++)
+            for(int q = p + 1; q < phageCount; q++)
+                out << "," << interfaceLength(p, q);
+        for(int p = 0; p < phageCount; p++)
+        {
+            std::map<long, long>::const_iterator s = sizes[p].begin();
+            for(long size = 1; size <= siteCount; size *= 2)
+            {
+                long count = 0;
+                for(; s != sizes[p].end() && s->first < 2*size; ++s)
+                    count += s->second;
+                out << "," << count;
+            }
+        }
+        for(int p = 0; p < phageCount; p++)
+            for(int q = p; q < phageCount; q++)
+                for(int r = 1; r <= range; r++)
+                    out << "," << correlation(p, q, r);
+        out << "\n";
+    }
+
+private:
+    long side;
+    long siteCount;
+    bool periodic;
+    int phageCount;
+    int range;
+    std::vector<uint8_t> kind; //0 or the phage of the lysogen at every site, plus one
+    std::vector<int32_t> label; //node of the domain of every lysogen, -1 elsewhere
+    std::vector<int32_t> parent; //union-find forest of the labels; a root is its own parent
+    std::vector<int32_t> nodeSize; //sites of the domain, valid at the roots
+    std::map<long, long> sizes[maxPhageCount]; //number of domains of every size, by phage
+    std::vector<long> lysogens; //sites of every kind
+    std::vector<long> pairs; //pairIndex(a, b, r) for kinds a <= b
+    //breadth-first searches of a split: the sites each found, in order, and how many of them it has expanded
+    uint32_t stamp; //visitStamp of the sites found by the current split
+    std::vector<uint32_t> visitStamp;
+    std::vector<int32_t> visitOwner; //search that found a site
+    std::vector<long> found[4];
+    size_t expanded[4];
+    int group[4]; //searches that met are in the same group, named by one of them
+
+    long pairIndex(int kindA, int kindB, int r) const
+    {
+        if(kindA > kindB)
+            std::swap(kindA, kindB);
+        return ((kindA - 1)*phageCount + kindB - 1)*range + r - 1;
+    }
+
+    long partner(long site, int direction, long r) const //site r steps up, right, down or left (direction 0 to 3) of site, -1 if that is off a closed lattice
+    {
+        long j = site/side, k = site%side;
+        if(direction == 0) j -= r;
+        else if(direction == 1) k += r;
+        else if(direction == 2) j += r;
+        else k -= r;
+        if(periodic)
+            return ((j + side) % side)*side + (k + side) % side;
+        return (j < 0 || j >= side || k < 0 || k >= side) ? -1 : j*side + k;
+    }
+
+    void countPairs(long site, int siteKind, long sign) //adds sign for every pair between site, holding siteKind, and the lysogens in line with it
+    {
+        if(!siteKind)
+            return;
+        for(int r = 1; r <= range; r++)
+            for(int direction = 0; direction < 4; direction++)
+            {
+                long other = partner(site, direction, r);
+                if(other != -1 && kind[other])
+                    pairs[pairIndex(siteKind, kind[other], r)] += sign;
+            }
+    }
+
+    int32_t find(int32_t node)
+    {
+        while(parent[node] != node)
+        {
+            parent[node] = parent[parent[node]]; //path halving
+            node = parent[node];
+        }
+        return node;
+    }
+
+    int32_t newNode(int32_t size)
+    {
+        parent.push_back(parent.size());
+        nodeSize.push_back(size);
+        return parent.size() - 1;
+    }
+
+    void resize(int k, long from, long to) //a domain of phage k - 1 went from from to to sites (0 for none)
+    {
+        if(from && --sizes[k - 1][from] == 0)
+            sizes[k - 1].erase(from);
+        if(to)
+            sizes[k - 1][to]++;
+    }
+
+    void join(long site, int k) //site became a lysogen of kind k
+    {
+        int32_t roots[4];
+        int rootCount = 0;
+        for(int direction = 0; direction < 4; direction++)
+        {
+            long other = partner(site, direction, 1);
+            if(other == -1 || kind[other] != k || label[other] == -1)
+                continue;
+            int32_t root = find(label[other]);
+            bool seen = false;
+            for(int n = 0; n < rootCount; n++)
+                seen = seen || roots[n] == root;
+            if(!seen)
+                roots[rootCount++] = root;
+        }
+        if(!rootCount)
+        {
+            label[site] = newNode(1);
+            resize(k, 0, 1);
+            return;
+        }
+        int largest = 0;
+        for(int n = 1; n < rootCount; n++)
+            if(nodeSize[roots[n]] > nodeSize[roots[largest]])
+                largest = n;
+        int32_t root = roots[largest];
+        long total = 1;
+        for(int n = 0; n < rootCount; n++)
+        {
+            resize(k, nodeSize[roots[n]], 0);
+            total += nodeSize[roots[n]];
+            parent[roots[n]] = root;
+        }
+        nodeSize[root] = total;
+        label[site] = root;
+        resize(k, 0, total);
+    }
+
+    void leave(long site, int k) //site, which held a lysogen of kind k, no longer does
+    {
+        int32_t root = find(label[site]);
+        label[site] = -1;
+        resize(k, nodeSize[root], nodeSize[root] - 1);
+        nodeSize[root]--;
+
+        if(++stamp == 0) //wrapped around, older stamps could be mistaken for this one
+        {
+            visitStamp.assign(siteCount, 0);
+            stamp = 1;
+        }
+        int searches = 0;
+        for(int direction = 0; direction < 4; direction++)
+        {
+            long other = partner(site, direction, 1);
+            if(other == -1 || kind[other] != k || visitStamp[other] == stamp)
+                continue;
+            visitStamp[other] = stamp;
+            visitOwner[other] = searches;
+            found[searches].assign(1, other);
+            expanded[searches] = 0;
+            group[searches] = searches;
+            searches++;
+        }
+        if(searches < 2) //nothing can have split off
+            return;
+
+        for(;;)
+        {
+            int groups = 0, going = 0; //groups, and groups with a search that has sites left to expand
+            for(int s = 0; s < searches; s++)
+                if(group[s] == s)
+                {
+                    groups++;
+                    for(int m = 0; m < searches; m++)
+                        if(group[m] == s && expanded[m] < found[m].size())
+                        {
+                            going++;
+                            break;
+                        }
+                }
+            if(groups == 1) //all neighbours are still connected
+                return;
+            if(going <= 1)
+                break;
+            for(int s = 0; s < searches; s++) //one site per search
+            {
+                if(expanded[s] == found[s].size())
+                    continue;
+                long next = found[s][expanded[s]++];
+                for(int direction = 0; direction < 4; direction++)
+                {
+                    long other = partner(next, direction, 1);
+                    if(other == -1 || kind[other] != k)
+                        continue;
+                    if(visitStamp[other] != stamp)
+                    {
+                        visitStamp[other] = stamp;
+                        visitOwner[other] = s;
+                        found[s].push_back(other);
+                    }
+                    else if(group[visitOwner[other]] != group[s]) //met another group, which joins this one
+                    {
+                        int from = group[visitOwner[other]];
+                        for(int m = 0; m < searches; m++)
+                            if(group[m] == from)
+                                group[m] = group[s];
+                    }
+                }
+            }
+        }
+
+        //every group that ran out is a piece of its own; the one still going, or else the largest, keeps the label
+        long pieceSize[4] = {0, 0, 0, 0};
+        int keeper = -1;
+        for(int s = 0; s < searches; s++)
+        {
+            pieceSize[group[s]] += found[s].size();
+            if(expanded[s] < found[s].size())
+                keeper = group[s];
+        }
+        for(int g = 0; g < searches && keeper == -1; g++)
+            if(group[g] == g && (keeper == -1 || pieceSize[g] > pieceSize[keeper]))
+                keeper = g;
+        for(int g = 0; g < searches; g++)
+        {
+            if(group[g] != g || g == keeper)
+                continue;
+            int32_t piece = newNode(pieceSize[g]);
+            for(int s = 0; s < searches; s++)
+                if(group[s] == g)
+                    for(size_t n = 0; n < found[s].size(); n++)
+                        label[found[s][n]] = piece;
+            resize(k, nodeSize[root], nodeSize[root] - pieceSize[g]);
+            nodeSize[root] -= pieceSize[g];
+            resize(k, 0, pieceSize[g]);
+        }
+    }
+
+    void relabel() //labels every domain afresh with one Hoshen-Kopelman pass
+    {
+        parent.clear();
+        nodeSize.clear();
+        for(int p = 0; p < maxPhageCount; p++)
+            sizes[p].clear();
+        for(long site = 0; site < siteCount; site++)
+        {
+            label[site] = -1;
+            if(!kind[site])
+                continue;
+            long up = (site >= side) ? site - side : -1, left = (site % side) ? site - 1 : -1;
+            int32_t upRoot = (up != -1 && kind[up] == kind[site]) ? find(label[up]) : -1;
+            int32_t leftRoot = (left != -1 && kind[left] == kind[site]) ? find(label[left]) : -1;
+            if(upRoot == -1 && leftRoot == -1)
+                label[site] = newNode(0);
+            else if(upRoot == -1 || leftRoot == -1 || upRoot == leftRoot)
+                label[site] = std::max(upRoot, leftRoot);
+            else
+            {
+                parent[std::max(upRoot, leftRoot)] = std::min(upRoot, leftRoot);
+                label[site] = std::min(upRoot, leftRoot);
+            }
+        }
+        if(periodic) //domains that go across the edges
+            for(long n = 0; n < side; n++)
+            {
+                long ends[2][2] = {{n*side, n*side + side - 1}, {n, (side - 1)*side + n}}; //first and last site of row n, of column n
+                for(int e = 0; e < 2; e++)
+                {
+                    long a = ends[e][0], b = ends[e][1];
+                    if(kind[a] && kind[a] == kind[b])
+                    {
+                        int32_t rootA = find(label[a]), rootB = find(label[b]);
+                        parent[std::max(rootA, rootB)] = std::min(rootA, rootB);
+                    }
+                }
+            }
+        for(long site = 0; site < siteCount; site++)
+            if(kind[site])
+            {
+                label[site] = find(label[site]);
+                nodeSize[label[site]]++;
+            }
+        for(long site = 0; site < siteCount; site++)
+            if(kind[site] && parent[label[site]] == label[site]) //the first site of a domain marks its root as counted
+            {
+                sizes[kind[site] - 1][nodeSize[label[site]]]++;
+                parent[label[site]] = -1;
+            }
+        for(size_t node = 0; node < parent.size(); node++)
+            if(parent[node] == -1)
+                parent[node] = node;
+    }
+};
+
+#endif
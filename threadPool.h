@@ -0,0 +1,156 @@
+/////////////////////////////////////////////////////////////////////////////
+// Work-stealing thread pool
+// run(taskCount, task) calls task(taskIndex, workerIndex) once for every
+// task index and returns when all of them are done. The indices are dealt
+// out in contiguous blocks, one block per worker; a worker takes tasks from
+// the front of its own block and, once that is empty, steals from the back
+// of the other workers' blocks. The calling thread works as worker 0, so a
+// pool of one thread runs everything inline.
+//
+// Which worker runs a task is not deterministic. Tasks must only rely on
+// their task index (and scratch state owned by their workerIndex) if the
+// result is to be reproducible.
+/////////////////////////////////////////////////////////////////////////////
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool
+{
+public:
+    explicit ThreadPool(int threadCount) : queues(threadCount < 1 ? 1 : threadCount), job(0), remaining(0), generation(0), stopping(false)
+    {
+        for(int w = 1; w < size(); w++)
+            threads.push_back(std::thread(&ThreadPool::workerLoop, this, w));
+    }
+
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> guard(jobLock);
+            stopping = true;
+        }
+        jobReady.notify_all();
+        for(size_t n = 0; n < threads.size(); n++)
+            threads[n].join();
+    }
+
+    int size() const //number of workers, including the calling thread
+    {
+        return (int)queues.size();
+    }
+
+    static int hardwareThreads()
+    {
+        unsigned n = std::thread::hardware_concurrency();
+        return n ? (int)n : 1;
+    }
+
+    void run(long taskCount, const std::function<void(long, int)> &task)
+    {
+        if(taskCount <= 0)
+            return;
+        {
+            std::lock_guard<std::mutex> guard(jobLock);
+            job = &task; //published before any task can be taken
+            remaining = taskCount;
+            generation++;
+        }
+        for(int w = 0; w < size(); w++)
+        {
+            std::lock_guard<std::mutex> guard(queues[w].lock);
+            for(long n = taskCount*w/size(); n < taskCount*(w + 1)/size(); n++)
+                queues[w].tasks.push_back(n);
+        }
+        jobReady.notify_all();
+
+        work(0);
+        std::unique_lock<std::mutex> guard(jobLock);
+        jobDone.wait(guard, [this] { return remaining == 0; });
+        job = 0;
+    }
+
+private:
+    struct Queue
+    {
+        std::mutex lock;
+        std::deque<long> tasks;
+    };
+
+    std::vector<Queue> queues; //one block of task indices per worker
+    std::vector<std::thread> threads;
+    std::mutex jobLock;
+    std::condition_variable jobReady;
+    std::condition_variable jobDone;
+    const std::function<void(long, int)> *job;
+    std::atomic<long> remaining; //tasks of the current job that have not finished yet
+    long generation; //incremented for every job so that sleeping workers notice it
+    bool stopping;
+
+    bool takeTask(int worker, long &task)
+    {
+        {
+            std::lock_guard<std::mutex> guard(queues[worker].lock);
+            if(!queues[worker].tasks.empty())
+            {
+                task = queues[worker].tasks.front();
+                queues[worker].tasks.pop_front();
+                return true;
+            }
+        }
+        for(int n = 1; n < size(); n++) //own block is done, steal from the others
+        {
+            Queue &victim = queues[(worker + n) % size()];
+            std::lock_guard<std::mutex> guard(victim.lock);
+            if(!victim.tasks.empty())
+            {
+                task = victim.tasks.back();
+                victim.tasks.pop_back();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void work(int worker)
+    {
+        long task;
+        while(takeTask(worker, task))
+        {
+            (*job)(task, worker);
+            if(--remaining == 0)
+            {
+                std::lock_guard<std::mutex> guard(jobLock);
+                jobDone.notify_all();
+            }
+        }
+    }
+
+    void workerLoop(int worker)
+    {
+        long seen = 0;
+        for(;;)
+        {
+            {
+                std::unique_lock<std::mutex> guard(jobLock);
+                jobReady.wait(guard, [this, seen] { return stopping || generation != seen; });
+                if(stopping)
+                    return;
+                seen = generation;
+            }
+            work(worker);
+        }
+    }
+
+    ThreadPool(const ThreadPool &);
+    ThreadPool &operator=(const ThreadPool &);
+};
+
+#endif
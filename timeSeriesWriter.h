@@ -0,0 +1,310 @@
+/////////////////////////////////////////////////////////////////////////////
+// Buffered output of the population time series
+// record(t, population) is called at the start of every tick. The rows that
+// pass the decimation policy -- every N-th tick and/or only ticks where a
+// count changed -- are formatted into a large buffer. When the buffer is
+// full it is handed to a background thread that writes it out while the
+// simulation goes on with the other buffer. The last tick is always written
+// on close(), so the end of a decimated series is not lost. A series can be
+// continued after a restart from a checkpoint: flush() makes everything
+// recorded so far reach the file, bytes() tells how long it then is, and
+// open() with keepBytes cuts the file back to that length and appends.
+//
+// A row holds t, the number of bacteria, the lysogenic and lytic counts of
+// every phage (A first) and the number of healthy bacteria. Two formats are
+// available:
+//   csv     the infectedResults.csv layout, one text line per row
+//   binary  a 64-byte header followed by fixed-width little-endian int32
+//           rows, so the file can be memory-mapped as a (rows x columns)
+//           int32 array (numpy: np.memmap(file, np.int32, offset=64,
+//           shape=(rows, columns))). Header layout:
+//             char     magic[8]       "PHAGETS\0"
+//             uint32   version        1
+//             uint32   columnCount    3 + 2*phages, 7 for phages A and B
+//             uint32   headerBytes    64
+//             uint32   rowBytes       4*columnCount
+//             uint64   rowCount       written on close (0 if the run was cut short;
+//                                     the size of the file then tells)
+//             char     columns[32]    one letter per column: t, b (bacteria), then
+//                                     L/l for lysogenic/lytic A, M/m for B, N/n for C, ...
+//                                     and h (healthy), so "tbLlMmh" for two phages
+/////////////////////////////////////////////////////////////////////////////
+#ifndef TIME_SERIES_WRITER_H
+#define TIME_SERIES_WRITER_H
+
+#include <charconv>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include "populationCounts.h"
+
+enum SeriesFormat { csvSeries, binarySeries };
+
+class TimeSeriesWriter
+{
+public:
+    TimeSeriesWriter() : file(0), format(csvSeries), phageCount(2), columnCount(7), every(1), onChange(false), capacity(0), rowCount(0), totalBytes(0), lastTick(-1), lastWritten(true),
+                         last(), pendingBytes(0), stopping(false), failed(false)
+    {}
+
+    ~TimeSeriesWriter()
+    {
+        close();
+    }
+
+    //starts a new series in fileName, with the counts of the first phages phages (2: A and B); only ticks that are multiples of everyTicks are written, and
+    //with changesOnly only those where a count changed. With keepBytes > 0 the series already in fileName is continued after its first keepBytes bytes (see bytes); false if the file is shorter.
+    bool open(const std::string &fileName, SeriesFormat seriesFormat, long everyTicks = 1, bool changesOnly = false, int phages = 2, long keepBytes = 0, size_t bufferBytes = 1 << 22)
+    {
+        close();
+        if(keepBytes > 0)
+        {
+            file = fopen(fileName.c_str(), "r+b");
+            if(file && (fseek(file, 0, SEEK_END) != 0 || ftell(file) < keepBytes || ftruncate(fileno(file), keepBytes) != 0 || fseek(file, keepBytes, SEEK_SET) != 0))
+            {
+                fclose(file);
+                file = 0;
+            }
+        }
+        else
+            file = fopen(fileName.c_str(), "wb");
+        if(!file)
+            return false;
+        format = seriesFormat;
+        phageCount = phages;
+        columnCount = 3 + 2*phages;
+        every = everyTicks < 1 ? 1 : everyTicks;
+        onChange = changesOnly;
+        capacity = bufferBytes;
+        rowCount = 0;
+        totalBytes = keepBytes;
+        lastTick = -1;
+        lastWritten = true;
+        failed = false;
+        stopping = false;
+        pendingBytes = 0;
+        filling.clear();
+        filling.reserve(capacity + maxRowBytes);
+        pending.reserve(capacity + maxRowBytes);
+
+        if(keepBytes > 0)
+        {
+            if(format == binarySeries)
+                rowCount = (keepBytes - headerBytes)/(4*columnCount);
+        }
+        else if(format == binarySeries)
+        {
+            char header[headerBytes] = {0};
+            uint32_t fields[4] = {1, columnCount, headerBytes, 4*columnCount};
+            memcpy(header, "PHAGETS", 8);
+            memcpy(header + 8, fields, sizeof(fields));
+            char *letter = header + 32;
+            *letter++ = 't';
+            *letter++ = 'b';
+            for(int p = 0; p < phageCount; p++)
+            {
+                *letter++ = (char)('L' + p);
+                *letter++ = (char)('l' + p);
+            }
+            *letter = 'h';
+            filling.insert(filling.end(), header, header + headerBytes);
+        }
+        else
+        {
+            std::string columns = "t,bacteriaCount";
+            for(int p = 0; p < phageCount; p++)
+                columns += std::string(",lysogenicBacteriaCount") + phageLetter(p) + ",lyticBacteriaCount" + phageLetter(p);
+            columns += ",healthyBacteriaCount\n";
+            filling.insert(filling.end(), columns.begin(), columns.end());
+        }
+        totalBytes += filling.size();
+        writer = std::thread(&TimeSeriesWriter::writerLoop, this);
+        return true;
+    }
+
+    void record(long t, const PopulationCounts &population) //called at the start of every tick
+    {
+        if(!file)
+            return;
+        lastTick = t;
+        lastCounts = population;
+        lastWritten = false;
+        if(t % every)
+            return;
+        if(onChange && rowCount && sameCounts(population, last))
+            return;
+        append(t, population);
+    }
+
+    bool close() //writes everything that is left and closes the file; false if anything could not be written
+    {
+        if(!file)
+            return !failed;
+        if(!lastWritten)
+            append(lastTick, lastCounts);
+        handOver();
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            stopping = true;
+        }
+        wakeWriter.notify_all();
+        writer.join();
+        if(format == binarySeries && !failed)
+        {
+            uint64_t rows = rowCount;
+            failed = fseek(file, 24, SEEK_SET) != 0 || fwrite(&rows, sizeof(rows), 1, file) != 1;
+        }
+        failed = (fclose(file) != 0) || failed;
+        file = 0;
+        return !failed;
+    }
+
+    void flush() //waits until everything recorded so far is in the file
+    {
+        if(!file)
+            return;
+        handOver();
+        std::unique_lock<std::mutex> guard(lock);
+        writerDone.wait(guard, [this] { return pendingBytes == 0; });
+        if(fflush(file) != 0)
+            failed = true;
+    }
+
+    long rows() const //rows written (or buffered) so far
+    {
+        return rowCount;
+    }
+
+    long bytes() const //length of the file once everything recorded so far is written
+    {
+        return totalBytes;
+    }
+
+    //fills values with the row of tick t for phages phages (see above) and returns its number of columns, 3 + 2*phages
+    static uint32_t rowValues(long t, const PopulationCounts &population, int phages, long values[3 + 2*maxPhageCount])
+    {
+        values[0] = t;
+        values[1] = population.bacteriaCount;
+        for(int p = 0; p < phages; p++)
+        {
+            values[2 + 2*p] = population.lysogenicBacteriaCount[p];
+            values[3 + 2*p] = population.lyticBacteriaCount[p];
+        }
+        values[2 + 2*phages] = population.healthyBacteriaCount();
+        return 3 + 2*phages;
+    }
+
+private:
+    static const uint32_t headerBytes = 64;
+    static const size_t maxRowBytes = (3 + 2*maxPhageCount)*21; //every column a long in text, with separators
+
+    FILE *file;
+    SeriesFormat format;
+    int phageCount;
+    uint32_t columnCount;
+    long every;
+    bool onChange;
+    size_t capacity; //a full buffer is handed to the writer thread
+    long rowCount;
+    long totalBytes;
+    long lastTick; //last tick recorded, and whether it has been written
+    bool lastWritten;
+    PopulationCounts last; //counts of the last row written
+    PopulationCounts lastCounts; //counts of the last tick recorded
+
+    std::vector<char> filling; //buffer being filled by record
+    std::vector<char> pending; //buffer being written by the writer thread
+    size_t pendingBytes; //bytes in pending still to be written, 0 once the writer is done with it
+    std::thread writer;
+    std::mutex lock;
+    std::condition_variable wakeWriter;
+    std::condition_variable writerDone;
+    bool stopping;
+    bool failed;
+
+    bool sameCounts(const PopulationCounts &a, const PopulationCounts &b) const
+    {
+        if(a.bacteriaCount != b.bacteriaCount)
+            return false;
+        for(int p = 0; p < phageCount; p++)
+            if(a.lysogenicBacteriaCount[p] != b.lysogenicBacteriaCount[p] || a.lyticBacteriaCount[p] != b.lyticBacteriaCount[p])
+                return false;
+        return true;
+    }
+
+    void append(long t, const PopulationCounts &population)
+    {
+        long values[3 + 2*maxPhageCount];
+        rowValues(t, population, phageCount, values);
+        size_t end = filling.size();
+        filling.resize(end + maxRowBytes);
+        char *out = &filling[end];
+        if(format == binarySeries)
+        {
+            for(uint32_t c = 0; c < columnCount; c++)
+            {
+                int32_t value = (int32_t)values[c];
+                memcpy(out, &value, 4);
+                out += 4;
+            }
+        }
+        else
+        {
+            for(uint32_t c = 0; c < columnCount; c++)
+            {
+                out = std::to_chars(out, out + 20, values[c]).ptr;
+                *out++ = (c + 1 < columnCount) ? ',' : '\n';
+            }
+        }
+        totalBytes += out - &filling[end];
+        filling.resize(out - &filling[0]);
+        last = population;
+        lastWritten = (t == lastTick);
+        rowCount++;
+        if(filling.size() >= capacity)
+            handOver();
+    }
+
+    void handOver() //waits for the writer to finish the previous buffer and gives it the current one
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        writerDone.wait(guard, [this] { return pendingBytes == 0; });
+        pending.swap(filling);
+        pendingBytes = pending.size();
+        filling.clear();
+        guard.unlock();
+        wakeWriter.notify_all();
+    }
+
+    void writerLoop()
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        for(;;)
+        {
+            wakeWriter.wait(guard, [this] { return stopping || pendingBytes != 0; });
+            if(pendingBytes)
+            {
+                size_t bytes = pendingBytes;
+                guard.unlock();
+                bool ok = fwrite(&pending[0], 1, bytes, file) == bytes; //pending is not touched by record until pendingBytes is back to 0
+                guard.lock();
+                failed = failed || !ok;
+                pendingBytes = 0;
+                writerDone.notify_all();
+            }
+            else if(stopping)
+                return;
+        }
+    }
+
+    TimeSeriesWriter(const TimeSeriesWriter &);
+    TimeSeriesWriter &operator=(const TimeSeriesWriter &);
+};
+
+#endif